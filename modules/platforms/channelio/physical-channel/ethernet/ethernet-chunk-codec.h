@@ -0,0 +1,77 @@
+//
+// Copyright (C) 2008 Intel Corporation
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+
+#ifndef __ETHERNET_CHUNK_CODEC__
+#define __ETHERNET_CHUNK_CODEC__
+
+#include <string.h>
+
+// The ethernet device moves 64 bit words.  A chunk narrower than that is
+// sent zero extended in a single word; a wider chunk is split into several
+// words, most significant word first, matching the hardware side.  Wide
+// chunks are taken apart through their in-memory representation, which on
+// our (little endian) hosts holds the least significant word first.
+// UINT64 comes from the asim headers, which the includer has pulled in.
+
+template <size_t WORDS, typename CHUNK>
+class ETHERNET_CHUNK_CODEC
+{
+  public:
+    static void Encode(const CHUNK& chunk, UINT64 *words)
+    {
+        const char *src = reinterpret_cast<const char *>(&chunk);
+        for (size_t i = 0; i < WORDS; i++)
+        {
+            size_t bytes = sizeof(CHUNK) - i * sizeof(UINT64);
+            words[WORDS - 1 - i] = 0;
+            memcpy(&words[WORDS - 1 - i], src + i * sizeof(UINT64),
+                   bytes < sizeof(UINT64) ? bytes : sizeof(UINT64));
+        }
+    }
+
+    static CHUNK Decode(const UINT64 *words)
+    {
+        CHUNK chunk;
+        char *dst = reinterpret_cast<char *>(&chunk);
+        for (size_t i = 0; i < WORDS; i++)
+        {
+            size_t bytes = sizeof(CHUNK) - i * sizeof(UINT64);
+            memcpy(dst + i * sizeof(UINT64), &words[WORDS - 1 - i],
+                   bytes < sizeof(UINT64) ? bytes : sizeof(UINT64));
+        }
+        return chunk;
+    }
+};
+
+// chunks of up to one word convert directly
+template <typename CHUNK>
+class ETHERNET_CHUNK_CODEC<1, CHUNK>
+{
+  public:
+    static void Encode(const CHUNK& chunk, UINT64 *words)
+    {
+        words[0] = UINT64(chunk);
+    }
+
+    static CHUNK Decode(const UINT64 *words)
+    {
+        return CHUNK(words[0]);
+    }
+};
+
+#endif
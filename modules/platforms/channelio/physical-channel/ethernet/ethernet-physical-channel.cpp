@@ -27,6 +27,7 @@
 #include <signal.h>
 #include <string.h>
 #include <iostream>
+#include <vector>
 
 #include "asim/provides/physical_channel.h"
 
@@ -49,6 +50,8 @@ PHYSICAL_CHANNEL_CLASS::PHYSICAL_CHANNEL_CLASS(
 {
     // cache links to useful physical devices
     ethernetDevice = d->GetEthernetDevice();
+    incomingMessage = NULL;
+    incomingWordCount = 0;
 }
 
 // destructor
@@ -99,7 +102,8 @@ PHYSICAL_CHANNEL_CLASS::TryRead()
     return NULL;
 }
 
-// write
+// write: safe to call from several threads at once. Messages are
+// marshalled in parallel and sent one at a time.
 void
 PHYSICAL_CHANNEL_CLASS::Write(
     UMF_MESSAGE message)
@@ -108,34 +112,31 @@ PHYSICAL_CHANNEL_CLASS::Write(
     // construct header
     UMF_CHUNK header = message->EncodeHeader();
 
-    // this gets ugly - we need to block until space is available
-    int header_ret = -1;
-
-    while (header_ret == -1)
-    {
-        header_ret = ethernetDevice.enq(UINT64(header));
-    }
-
-    // write message data to physical channel
+    // gather the header and message data so that the ethernet device can
+    // pack the whole message into as few packets as possible
     // NOTE: hardware demarshaller expects chunk pattern to start from most
     //       significant chunk and end at least significant chunk, so we will
     //       send chunks in reverse order
 
+    vector<UINT64> words;
+    UINT64 chunkWords[ETHERNET_WORDS_PER_CHUNK];
+
+    ETHERNET_CHUNK_CODEC_CLASS::Encode(header, chunkWords);
+    words.insert(words.end(), chunkWords, chunkWords + ETHERNET_WORDS_PER_CHUNK);
+
     message->StartReverseExtract();
     while (message->CanReverseExtract())
     {
         UMF_CHUNK chunk = message->ReverseExtractChunk();
-
-        // once again block until space is available
-        int ret = -1;
-
-        while (ret == -1)
-        {
-            ret = ethernetDevice.enq(UINT64(chunk));
-        }
-
+        ETHERNET_CHUNK_CODEC_CLASS::Encode(chunk, chunkWords);
+        words.insert(words.end(), chunkWords, chunkWords + ETHERNET_WORDS_PER_CHUNK);
     }
 
+    // the device blocks until enough credit is available, and sends the
+    // words of a single call contiguously, so messages written by
+    // different threads never interleave
+    ethernetDevice->enq(&words[0], words.size());
+
     // de-allocate message
     message->Delete();
 }
@@ -145,38 +146,40 @@ PHYSICAL_CHANNEL_CLASS::Write(
 void
 PHYSICAL_CHANNEL_CLASS::readFIFO()
 {
-    UMF_CHUNK chunk;
-    UINT64 inc;
-
-    // check cached pointers to see if we can actually read anything
-    if (pchannel->empty())
+    if (incomingMessage && !incomingMessage->CanAppend())
     {
+        // uh-oh.. we already have a full message, but it hasn't been
+        // asked for yet. We will simply not read the pipe, but in
+        // future, we might want to include a read buffer.
         return;
     }
 
+    // collect the words of one chunk; a wide chunk may arrive over
+    // several calls, so the words read so far are kept
+    while (incomingWordCount < ETHERNET_WORDS_PER_CHUNK)
+    {
+        // check cached pointers to see if we can actually read anything
+        if (ethernetDevice->empty())
+        {
+            return;
+        }
+
+        ethernetDevice->deq(&incomingWords[incomingWordCount]);
+        incomingWordCount++;
+    }
+
+    UMF_CHUNK chunk = ETHERNET_CHUNK_CODEC_CLASS::Decode(incomingWords);
+    incomingWordCount = 0;
+
     // determine if we are starting a new message
     if (incomingMessage == NULL)
     {
-        // read up to one chunk
-        int ret = pciExpressDevice->deq(&inc);
-        chunk = UMF_CHUNK(inc);
-
         // new message
         incomingMessage = UMF_MESSAGE_CLASS::New();
         incomingMessage->DecodeHeader(chunk);
     }
-    else if (!incomingMessage->CanAppend())
-    {
-        // uh-oh.. we already have a full message, but it hasn't been
-        // asked for yet. We will simply not read the pipe, but in
-        // future, we might want to include a read buffer.
-    }
     else
     {
-        // read up to one chunk
-        int ret = pciExpressDevice->deq(&inc);
-        chunk = UMF_CHUNK(inc);
-
         // read in some more bytes for the current message
         incomingMessage->AppendChunk(chunk);
     }
@@ -23,6 +23,17 @@
 #include "asim/provides/ethernet_device.h"
 #include "asim/provides/physical_platform.h"
 
+#include "ethernet-chunk-codec.h"
+
+// ============================================
+//             Chunk <-> Word Codec
+// ============================================
+
+// chunks are split into the ethernet device's 64 bit words by the codec
+#define ETHERNET_WORDS_PER_CHUNK ((sizeof(UMF_CHUNK) + sizeof(UINT64) - 1) / sizeof(UINT64))
+
+typedef ETHERNET_CHUNK_CODEC<ETHERNET_WORDS_PER_CHUNK, UMF_CHUNK> ETHERNET_CHUNK_CODEC_CLASS;
+
 // ============================================
 //               Physical Channel              
 // ============================================
@@ -37,6 +48,12 @@ class PHYSICAL_CHANNEL_CLASS: public PLATFORMS_MODULE_CLASS
     // incomplete incoming read message
     UMF_MESSAGE incomingMessage;
 
+    // words of a chunk that has not been completely received yet
+    UINT64 incomingWords[ETHERNET_WORDS_PER_CHUNK];
+    UINT32 incomingWordCount;
+
+    void readFIFO();                // read one chunk's worth of unread data
+
   public:
 
     PHYSICAL_CHANNEL_CLASS(PLATFORMS_MODULE, PHYSICAL_DEVICES);
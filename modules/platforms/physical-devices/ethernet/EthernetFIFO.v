@@ -35,10 +35,37 @@
 //	Description:	This module connects to the Ethernet PHY and provides a 64
 //			bit wide FIFO interface.
 //	Parameters:	MACAddress:		The hardware MAC address assigned to this device
+//			IPAddress:		The IPv4 address assigned to this device
 //			HostBufferSize:		The depth of the FIFO on the remote end of
 //						the Ethernet link
 //			FIFO_FWFT		Sets whether the output of the FIFO
 //						interface uses First Word Fall Through
+//			CompressEnable		Negotiate compressed (zero-eliding,
+//						run-length) data packets with the host
+//			BulkEnable		Accept bulk data packets from the host and
+//						present them on the BULK interface
+//			DeepBufferEnable	Spill host-to-FPGA words into a ring buffer in
+//						DDR2 (via the SPILL interface) once the
+//						on-chip FIFOs fill
+//			DeepBufferBase		DDR2 byte address of the spill ring buffer
+//						(bulk writes must stay below it)
+//			DeepBufferAWidth	log2 of the spill ring buffer size in words
+//						(at most 15, as credit is counted in 16 bits)
+//			CutThrough		Exchange multi-word data packets with hosts that
+//						support them; received words are written to the
+//						FIFO as soon as they arrive
+//			RxFillTimeout		Cycles a received data packet may wait for its
+//						frame status before it is abandoned (0 = never)
+//			TxFrameWords		Largest data packet sent to the host, in words
+//			TxFillTimeout		Cycles to wait for an outgoing data packet to
+//						fill before starting it (0 = start immediately)
+//			CreditEnable		Return credit on data packets, and in counted
+//						tokens, to hosts that support them
+//			UDPEnable		Also accept packets encapsulated in UDP/IPv4,
+//						and answer a host that pings over UDP in kind
+//						(there is no ARP responder, so hosts need a
+//						static ARP entry for IPAddress and MACAddress)
+//			UDPPort			UDP port of this device
 //	Author:		Rimas Avizienis
 //	Version:	
 //------------------------------------------------------------------------------
@@ -57,6 +84,29 @@ module	EthernetFIFO(
 			EMPTY_N,
 			//------------------------------------------------------------------
 
+			//------------------------------------------------------------------
+			//	Bulk Write Interface
+			//------------------------------------------------------------------
+			BULK_ADDR,
+			BULK_D_OUT,
+			BULK_DEQ,
+			BULK_EMPTY_N,
+			//------------------------------------------------------------------
+
+			//------------------------------------------------------------------
+			//	Spill Memory Interface
+			//------------------------------------------------------------------
+			SPILL_WR_ADDR,
+			SPILL_WR_DATA,
+			SPILL_WR_DEQ,
+			SPILL_WR_EMPTY_N,
+			SPILL_RD_ADDR,
+			SPILL_RD_DEQ,
+			SPILL_RD_EMPTY_N,
+			SPILL_RSP_DATA,
+			SPILL_RSP_ENQ,
+			//------------------------------------------------------------------
+
 			//------------------------------------------------------------------
 			//	Clock Input
 			//------------------------------------------------------------------
@@ -91,8 +141,32 @@ module	EthernetFIFO(
 	//--------------------------------------------------------------------------
 	
 	parameter		MACAddress = 		48'h112233445566;
+	parameter		IPAddress =		32'hC0A80A02;
 	parameter		HostBufferSize = 	512;
 	parameter		FIFO_FWFT = 		"TRUE";
+	parameter		CompressEnable =	1;
+	parameter		BulkEnable =		1;
+	parameter		DeepBufferEnable =	0;
+	parameter		DeepBufferBase =	64'h0000000010000000;
+	parameter		DeepBufferAWidth =	15;
+	parameter		CutThrough =		1;
+	parameter		RxFillTimeout =		256;
+	parameter		TxFrameWords =		32;
+	parameter		TxFillTimeout =		0;
+	parameter		CreditEnable =		1;
+	parameter		UDPEnable =		1;
+	parameter		UDPPort =		16'h8888;
+
+	//	Credit window advertised to the host: the RX FIFO, plus the spill
+	//	ring buffer if enabled (the output FIFO in front of it is slack)
+	localparam		RxWindow =		DeepBufferEnable ? 512 + (1 << DeepBufferAWidth) : 512;
+
+	//	Credit moves in 16 bit counts (the token bank, the credit word and
+	//	the host's credit field), so a larger window cannot be returned.
+	//	Instantiating a module that does not exist stops elaboration.
+	generate if (RxWindow > 16'hFFFF) begin : rx_window_check
+		DeepBufferAWidth_must_be_less_than_16	error();
+	end endgenerate
 
 	//--------------------------------------------------------------------------
 	//	FIFO Interface
@@ -107,6 +181,29 @@ module	EthernetFIFO(
 	input			DEQ;
 	output			EMPTY_N; 
 
+	//--------------------------------------------------------------------------
+	//	Bulk Write Interface (each word with the DDR2 byte address it goes to)
+	//--------------------------------------------------------------------------
+
+	output	[63:0]		BULK_ADDR;
+	output	[63:0]		BULK_D_OUT;
+	input			BULK_DEQ;
+	output			BULK_EMPTY_N;
+
+	//--------------------------------------------------------------------------
+	//	Spill Memory Interface (DDR2 requests, read data returned in order)
+	//--------------------------------------------------------------------------
+
+	output	[63:0]		SPILL_WR_ADDR;
+	output	[63:0]		SPILL_WR_DATA;
+	input			SPILL_WR_DEQ;
+	output			SPILL_WR_EMPTY_N;
+	output	[63:0]		SPILL_RD_ADDR;
+	input			SPILL_RD_DEQ;
+	output			SPILL_RD_EMPTY_N;
+	input	[63:0]		SPILL_RSP_DATA;
+	input			SPILL_RSP_ENQ;
+
 	//--------------------------------------------------------------------------
 	//	100 MHz clock input (used to generate 125 MHz clock for PHY)
 	//--------------------------------------------------------------------------
@@ -150,6 +247,21 @@ module	EthernetFIFO(
 
 	wire [63:0]		rx_dout, txfifo_dout;
 	wire [47:0]		rx_source_mac;
+	wire [7:0]		rx_host_caps;
+	wire			rx_host_udp;
+	wire [31:0]		rx_source_ip;
+	wire [15:0]		rx_source_port;
+
+	wire			bulkfifo_full, bulkfifo_empty, bulkfifo_we, bulkfifo_re;
+	wire			bulkdesc_empty, bulkdesc_we, bulkdesc_re;
+	wire			bulkack_empty, bulkack_we, bulkack_re;
+	wire [63:0]		bulk_dout, bulkfifo_dout;
+	wire [71:0]		bulk_desc, bulkdesc_dout;
+	wire [8:0]		bulkack_din;
+	wire [15:0]		bulkack_dout;
+
+	wire			rxfifo_re;
+	wire [63:0]		rxfifo_dout;
 
 	wire [7:0]		rx_data, tx_data; 	 
 	wire			rx_data_valid, tx_data_valid, tx_ack;
@@ -181,7 +293,6 @@ module	EthernetFIFO(
 	assign	reset = 	~RST_N;
 	assign	PHY_RESET = 	RST_N;
 	assign	FULL_N = 	~txfifo_full;
-	assign	EMPTY_N = 	~rxfifo_empty;
 	assign	idelayctrl_reset_0_i = idelayctrl_reset_0_r[12];	
 
 	//--------------------------------------------------------------------------
@@ -189,7 +300,15 @@ module	EthernetFIFO(
 	//--------------------------------------------------------------------------
 
 	EthernetFIFORx	#(
-			.MACAddress(MACAddress)
+			.MACAddress			(MACAddress),
+			.IPAddress			(IPAddress),
+			.CompressEnable			(CompressEnable),
+			.BulkEnable			(BulkEnable),
+			.CutThrough			(CutThrough),
+			.RxFillTimeout			(RxFillTimeout),
+			.CreditEnable			(CreditEnable),
+			.UDPEnable			(UDPEnable),
+			.UDPPort			(UDPPort)
 			) EthernetFIFORx_if (
 			.clk				(rx_client_clk_0),
 			.reset				(rx_reset_0_i),
@@ -200,9 +319,18 @@ module	EthernetFIFO(
 			.rxfifo_full			(rxfifo_full),
 			.rxfifo_we			(rxfifo_we),
 			.rx_dout			(rx_dout),
+			.bulkfifo_full			(bulkfifo_full),
+			.bulkfifo_we			(bulkfifo_we),
+			.bulk_dout			(bulk_dout),
+			.bulkdesc_we			(bulkdesc_we),
+			.bulk_desc			(bulk_desc),
 			.tx_send_ack			(tx_send_ack),
 			.tx_credit_incr			(tx_credit_incr),
 			.rx_source_mac			(rx_source_mac),
+			.rx_host_caps			(rx_host_caps),
+			.rx_host_udp			(rx_host_udp),
+			.rx_source_ip			(rx_source_ip),
+			.rx_source_port			(rx_source_port),
 			.rx_error			(RX_ERROR));
 		
 	//--------------------------------------------------------------------------
@@ -228,7 +356,17 @@ module	EthernetFIFO(
 	//--------------------------------------------------------------------------
 
 	EthernetFIFOTx	#(
-			.MACAddress			(MACAddress)
+			.MACAddress			(MACAddress),
+			.IPAddress			(IPAddress),
+			.CompressEnable			(CompressEnable),
+			.BulkEnable			(BulkEnable),
+			.RxWindow			(RxWindow),
+			.CutThrough			(CutThrough),
+			.TxFrameWords			(TxFrameWords),
+			.TxFillTimeout			(TxFillTimeout),
+			.CreditEnable			(CreditEnable),
+			.UDPEnable			(UDPEnable),
+			.UDPPort			(UDPPort)
 			) EthernetFIFOTx_if (
 			.clk				(tx_client_clk_0),
 			.reset				(tx_reset_0_i),
@@ -243,7 +381,14 @@ module	EthernetFIFO(
 			.tx_send_token			(tx_send_token),
 			.tx_send_ack			(tx_send_ack),
 			.rx_token_decr			(rx_token_decr),
-			.tx_dest_mac			(rx_source_mac));
+			.tx_dest_mac			(rx_source_mac),
+			.tx_host_caps			(rx_host_caps),
+			.tx_host_udp			(rx_host_udp),
+			.tx_dest_ip			(rx_source_ip),
+			.tx_dest_port			(rx_source_port),
+			.tx_send_bulk_ack		(~bulkack_empty),
+			.tx_bulk_ack			(bulkack_dout[8:0]),
+			.bulk_ack_re			(bulkack_re));
 
 	//--------------------------------------------------------------------------
 	//	Asynchronous semaphore to track receive credit tokens to send
@@ -251,7 +396,7 @@ module	EthernetFIFO(
 
 	FIFOSemaphore 	#(
 			.Asynchronous			(1),
-			.Buffering			(512) 
+			.Buffering			(RxWindow) 
 			) RXToken_Semaphore (
 			.Reset				(reset),
 			.InClock			(CLK),
@@ -272,19 +417,87 @@ module	EthernetFIFO(
 			.EN_ECC_READ			("FALSE"),
 			.EN_ECC_WRITE			("FALSE"),
 			.EN_SYN				("FALSE"),
-			.FIRST_WORD_FALL_THROUGH	(FIFO_FWFT)
+			.FIRST_WORD_FALL_THROUGH	(DeepBufferEnable ? "TRUE" : FIFO_FWFT)
 			) rxfifo (
-			.DO				(D_OUT),
+			.DO				(rxfifo_dout),
 			.EMPTY				(rxfifo_empty),
 			.FULL				(rxfifo_full),
 			.DI				(rx_dout),
 			.DIP				(8'b0),
 			.RDCLK				(CLK),
-			.RDEN				(DEQ),
+			.RDEN				(rxfifo_re),
 			.RST				(rx_reset_0_i),
 			.WRCLK				(rx_client_clk_0),
 			.WREN				(rxfifo_we));
 
+	//--------------------------------------------------------------------------
+	//	Optional DDR2 spill tier between the RX Fifo and the user
+	//--------------------------------------------------------------------------
+
+	generate if (DeepBufferEnable) begin : deep_buffer
+
+		wire			outfifo_empty, outfifo_we;
+		wire [63:0]		outfifo_din;
+
+		assign	EMPTY_N = 	~outfifo_empty;
+
+		EthernetFIFOSpill #(
+			.SpillBase			(DeepBufferBase),
+			.SpillAWidth			(DeepBufferAWidth)
+			) EthernetFIFOSpill_if (
+			.clk				(CLK),
+			.reset				(reset),
+			.rxfifo_empty			(rxfifo_empty),
+			.rxfifo_re			(rxfifo_re),
+			.rxfifo_data			(rxfifo_dout),
+			.outfifo_we			(outfifo_we),
+			.outfifo_data			(outfifo_din),
+			.outfifo_re			(DEQ),
+			.spill_wr_addr			(SPILL_WR_ADDR),
+			.spill_wr_data			(SPILL_WR_DATA),
+			.spill_wr_valid			(SPILL_WR_EMPTY_N),
+			.spill_wr_deq			(SPILL_WR_DEQ),
+			.spill_rd_addr			(SPILL_RD_ADDR),
+			.spill_rd_valid			(SPILL_RD_EMPTY_N),
+			.spill_rd_deq			(SPILL_RD_DEQ),
+			.spill_rsp_data			(SPILL_RSP_DATA),
+			.spill_rsp_valid		(SPILL_RSP_ENQ));
+
+		//	Output Fifo (512 entries deep x 64 bits wide)
+
+		FIFO36_72 	#(
+			.DO_REG				(1),
+			.EN_ECC_READ			("FALSE"),
+			.EN_ECC_WRITE			("FALSE"),
+			.EN_SYN				("FALSE"),
+			.FIRST_WORD_FALL_THROUGH	(FIFO_FWFT)
+			) outfifo (
+			.DO				(D_OUT),
+			.EMPTY				(outfifo_empty),
+			.FULL				(),
+			.DI				(outfifo_din),
+			.DIP				(8'b0),
+			.RDCLK				(CLK),
+			.RDEN				(DEQ),
+			.RST				(reset),
+			.WRCLK				(CLK),
+			.WREN				(outfifo_we));
+
+	end
+	else begin : no_deep_buffer
+
+		assign	EMPTY_N = 	~rxfifo_empty;
+		assign	D_OUT =		rxfifo_dout;
+		assign	rxfifo_re =	DEQ;
+
+		assign	SPILL_WR_ADDR =		64'h0;
+		assign	SPILL_WR_DATA =		64'h0;
+		assign	SPILL_WR_EMPTY_N =	1'b0;
+		assign	SPILL_RD_ADDR =		64'h0;
+		assign	SPILL_RD_EMPTY_N =	1'b0;
+
+	end endgenerate
+
 	//--------------------------------------------------------------------------
 	//	TX Fifo (512 entries deep x 64 bits wide)
 	//--------------------------------------------------------------------------
@@ -307,6 +520,97 @@ module	EthernetFIFO(
 			.WRCLK				(CLK),
 			.WREN				(ENQ));
 		
+	//--------------------------------------------------------------------------
+	//	Bulk data Fifo (512 entries deep x 64 bits wide, i.e. 4 bulk packets,
+	//	which must match RAMP_BULK_FRAMES on the host)
+	//--------------------------------------------------------------------------
+
+	FIFO36_72 	#(
+			.DO_REG				(1),
+			.EN_ECC_READ			("FALSE"),
+			.EN_ECC_WRITE			("FALSE"),
+			.EN_SYN				("FALSE"),
+			.FIRST_WORD_FALL_THROUGH	("TRUE")
+			) bulkfifo (
+			.DO				(bulkfifo_dout),
+			.EMPTY				(bulkfifo_empty),
+			.FULL				(bulkfifo_full),
+			.DI				(bulk_dout),
+			.DIP				(8'b0),
+			.RDCLK				(CLK),
+			.RDEN				(bulkfifo_re),
+			.RST				(rx_reset_0_i),
+			.WRCLK				(rx_client_clk_0),
+			.WREN				(bulkfifo_we));
+
+	//--------------------------------------------------------------------------
+	//	Bulk descriptor Fifo (one 72 bit entry per bulk packet)
+	//--------------------------------------------------------------------------
+
+	FIFO36_72 	#(
+			.DO_REG				(1),
+			.EN_ECC_READ			("FALSE"),
+			.EN_ECC_WRITE			("FALSE"),
+			.EN_SYN				("FALSE"),
+			.FIRST_WORD_FALL_THROUGH	("TRUE")
+			) bulkdesc (
+			.DO				(bulkdesc_dout[63:0]),
+			.DOP				(bulkdesc_dout[71:64]),
+			.EMPTY				(bulkdesc_empty),
+			.FULL				(),
+			.DI				(bulk_desc[63:0]),
+			.DIP				(bulk_desc[71:64]),
+			.RDCLK				(CLK),
+			.RDEN				(bulkdesc_re),
+			.RST				(rx_reset_0_i),
+			.WRCLK				(rx_client_clk_0),
+			.WREN				(bulkdesc_we));
+
+	//--------------------------------------------------------------------------
+	//	Bulk write control
+	//--------------------------------------------------------------------------
+
+	//	With the deep buffer enabled, bulk writes are kept below its spill
+	//	ring, which starts at DeepBufferBase
+	EthernetFIFOBulk #(
+			.BulkLimit			(DeepBufferEnable ? DeepBufferBase : 64'h0000000000000000)
+			) EthernetFIFOBulk_if (
+			.clk				(CLK),
+			.reset				(reset),
+			.bulkfifo_empty			(bulkfifo_empty),
+			.bulkfifo_re			(bulkfifo_re),
+			.bulkfifo_data			(bulkfifo_dout),
+			.bulkdesc_empty			(bulkdesc_empty),
+			.bulkdesc_re			(bulkdesc_re),
+			.bulkdesc_data			(bulkdesc_dout),
+			.bulkack_we			(bulkack_we),
+			.bulkack_data			(bulkack_din),
+			.bulk_addr			(BULK_ADDR),
+			.bulk_data			(BULK_D_OUT),
+			.bulk_valid			(BULK_EMPTY_N),
+			.bulk_deq			(BULK_DEQ));
+
+	//--------------------------------------------------------------------------
+	//	Bulk acknowledgement Fifo ({status, seq} of each drained bulk packet)
+	//--------------------------------------------------------------------------
+
+	FIFO18 		#(
+			.DATA_WIDTH			(18),
+			.DO_REG				(1),
+			.EN_SYN				("FALSE"),
+			.FIRST_WORD_FALL_THROUGH	("TRUE")
+			) bulkack (
+			.DO				(bulkack_dout),
+			.EMPTY				(bulkack_empty),
+			.FULL				(),
+			.DI				({7'b0, bulkack_din}),
+			.DIP				(2'b0),
+			.RDCLK				(tx_client_clk_0),
+			.RDEN				(bulkack_re),
+			.RST				(tx_reset_0_i),
+			.WRCLK				(CLK),
+			.WREN				(bulkack_we));
+
 	//--------------------------------------------------------------------------
 	//	DCM to generate 125 MHz GTXCLK and 200 MHZ REFCLK from 100MHz clock input
 	//--------------------------------------------------------------------------
@@ -0,0 +1,170 @@
+//==============================================================================
+//	Section:	License
+//==============================================================================
+//	Copyright (c) 2005-2009, Regents of the University of California
+//	All rights reserved.
+//
+//	Redistribution and use in source and binary forms, with or without modification,
+//	are permitted provided that the following conditions are met:
+//
+//		- Redistributions of source code must retain the above copyright notice,
+//			this list of conditions and the following disclaimer.
+//		- Redistributions in binary form must reproduce the above copyright
+//			notice, this list of conditions and the following disclaimer
+//			in the documentation and/or other materials provided with the
+//			distribution.
+//		- Neither the name of the University of California, Berkeley nor the
+//			names of its contributors may be used to endorse or promote
+//			products derived from this software without specific prior
+//			written permission.
+//
+//	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+//	ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+//	ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+//------------------------------------------------------------------------------
+//	Module:		EthernetFIFOBulk
+//	Description:	This module drains the bulk data and descriptor FIFOs
+//			filled by EthernetFIFORx, presenting each data word with
+//			its DDR2 byte address to the user, and queues an
+//			acknowledgement once every word of a bulk packet has
+//			been taken.  Words of packets that failed the CRC check
+//			are discarded without being presented, and packets
+//			rejected for their length arrive with no words; both are
+//			acknowledged with a failure status.  So are packets that
+//			reach BulkLimit, whose words are discarded too.
+//	Parameters:	BulkLimit:		DDR2 byte address bulk writes must stay
+//						below (0 = no limit)
+//			
+//	Version:	
+//------------------------------------------------------------------------------
+
+module EthernetFIFOBulk(
+			//------------------------------------------------------------------
+			//	System Inputs
+			//------------------------------------------------------------------
+			clk,
+			reset,
+			//------------------------------------------------------------------
+			//	Interface to bulk data and descriptor FIFOs
+			//------------------------------------------------------------------
+			bulkfifo_empty,
+			bulkfifo_re,
+			bulkfifo_data,
+			bulkdesc_empty,
+			bulkdesc_re,
+			bulkdesc_data,
+			//------------------------------------------------------------------
+			//	Interface to bulk acknowledgement FIFO
+			//------------------------------------------------------------------
+			bulkack_we,
+			bulkack_data,
+			//------------------------------------------------------------------
+			//	User interface
+			//------------------------------------------------------------------
+			bulk_addr,
+			bulk_data,
+			bulk_valid,
+			bulk_deq
+	);
+
+	//--------------------------------------------------------------------------
+	//	Parameters
+	//--------------------------------------------------------------------------
+
+	parameter		BulkLimit =	64'h0000000000000000;
+
+	//--------------------------------------------------------------------------
+	//	System inputs
+	//--------------------------------------------------------------------------
+
+	input			clk;
+	input			reset;
+
+	//--------------------------------------------------------------------------
+	//	Interface to bulk data and descriptor FIFOs
+	//--------------------------------------------------------------------------
+
+	input			bulkfifo_empty;
+	output			bulkfifo_re;
+	input [63:0]		bulkfifo_data;
+	input			bulkdesc_empty;
+	output			bulkdesc_re;
+	input [71:0]		bulkdesc_data;		// {good, seq[7:0], nwords[7:0], word address[54:0]}
+
+	//--------------------------------------------------------------------------
+	//	Interface to bulk acknowledgement FIFO
+	//--------------------------------------------------------------------------
+
+	output			bulkack_we;
+	output [8:0]		bulkack_data;		// {status, seq[7:0]}
+
+	//--------------------------------------------------------------------------
+	//	User interface
+	//--------------------------------------------------------------------------
+
+	output [63:0]		bulk_addr;		// DDR2 byte address of bulk_data
+	output [63:0]		bulk_data;
+	output			bulk_valid;
+	input			bulk_deq;
+
+	//--------------------------------------------------------------------------
+	//	Wires & Regs
+	//--------------------------------------------------------------------------
+
+	reg [7:0]		count;
+
+	wire			desc_good, desc_in_range;
+	wire [7:0]		desc_seq, desc_nwords;
+	wire [54:0]		desc_waddr;
+	wire			word_avail, take, last, desc_done;
+
+	//--------------------------------------------------------------------------
+	//	Assigns
+	//--------------------------------------------------------------------------
+
+	assign	desc_good =	bulkdesc_data[71] & desc_in_range;
+	assign	desc_seq =	bulkdesc_data[70:63];
+	assign	desc_nwords =	bulkdesc_data[62:55];
+	assign	desc_waddr =	bulkdesc_data[54:0];
+
+	// a packet is refused if its last word would be at or above BulkLimit
+	assign	desc_in_range =	(BulkLimit == 0) | ({1'b0, desc_waddr} + desc_nwords <= (BulkLimit >> 3));
+
+	// a descriptor's words are always in the data FIFO before the descriptor
+	assign	word_avail =	~bulkdesc_empty & ~bulkfifo_empty & (desc_nwords != 8'h00);
+	assign	take =		word_avail & (desc_good ? bulk_deq : 1'b1);
+	assign	last =		(count + 1 == desc_nwords);
+
+	// a bad frame may have been cut short before any of its words were written
+	assign	desc_done =	(take & last) | (~bulkdesc_empty & desc_nwords == 8'h00);
+
+	assign	bulk_addr =	{desc_waddr + count, 3'b000};
+	assign	bulk_data =	bulkfifo_data;
+	assign	bulk_valid =	word_avail & desc_good;
+
+	assign	bulkfifo_re =	take;
+	assign	bulkdesc_re =	desc_done;
+	assign	bulkack_we =	desc_done;
+	assign	bulkack_data =	{desc_good, desc_seq};
+
+	//--------------------------------------------------------------------------
+	//	Registers
+	//--------------------------------------------------------------------------
+
+	always @ (posedge clk) begin
+		if (reset | desc_done)
+			count <= 8'h00;
+		else if (take)
+			count <= count + 1;
+	end
+
+endmodule
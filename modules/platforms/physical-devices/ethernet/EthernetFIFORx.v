@@ -36,6 +36,21 @@
 //			of the EthernetFIFO interface
 //			
 //	Parameters:	MACAddress:		The hardware MAC address assigned to this device
+//			CompressEnable:		Accept compressed data packets from the host
+//			BulkEnable:		Accept bulk data packets from the host
+//			CutThrough:		Accept multi-word data packets, and write their
+//						words to the RX FIFO as soon as they have been
+//						received rather than after the CRC check
+//			MaxFrameWords:		Largest multi-word data packet accepted (in words)
+//			RxFillTimeout:		Cycles a data packet may wait for the MAC's frame
+//						status after the data stops before it is abandoned
+//						(0 to wait forever)
+//			CreditEnable:		Accept credit words on data packets and counted
+//						tokens from hosts that advertise them
+//			IPAddress:		The IPv4 address assigned to this device
+//			UDPEnable:		Also accept packets encapsulated in UDP/IPv4
+//						datagrams sent to UDPPort
+//			UDPPort:		UDP port of this device
 //
 //	Author:		Rimas Avizienis
 //	Version:	
@@ -61,11 +76,23 @@ module EthernetFIFORx (
 			rxfifo_we,
 			rx_dout,
 			//------------------------------------------------------------------
+			//	Interface to bulk data and descriptor FIFOs
+			//------------------------------------------------------------------
+			bulkfifo_full,
+			bulkfifo_we,
+			bulk_dout,
+			bulkdesc_we,
+			bulk_desc,
+			//------------------------------------------------------------------
 			//	Interface to EthernetFIFOTx module
 			//------------------------------------------------------------------
 			tx_send_ack,
 			tx_credit_incr,	
 			rx_source_mac,
+			rx_host_caps,
+			rx_host_udp,
+			rx_source_ip,
+			rx_source_port,
 			//------------------------------------------------------------------
 			//	Status output
 			//------------------------------------------------------------------							
@@ -77,6 +104,15 @@ module EthernetFIFORx (
 	//--------------------------------------------------------------------------
 
 	parameter 		MACAddress = 	48'h112233445566;
+	parameter		CompressEnable = 1;
+	parameter		BulkEnable =	1;
+	parameter		CutThrough =	1;
+	parameter		MaxFrameWords =	64;
+	parameter		RxFillTimeout =	256;
+	parameter		CreditEnable =	1;
+	parameter		IPAddress =	32'hC0A80A02;
+	parameter		UDPEnable =	1;
+	parameter		UDPPort =	16'h8888;
 
 	//--------------------------------------------------------------------------
 	//	System inputs
@@ -98,39 +134,87 @@ module EthernetFIFORx (
 	input			rxfifo_full;
 	output 			rxfifo_we;	// write enable to RX FIFO
 	output [63:0]		rx_dout;	// data output to RX FIFO
+
+	//--------------------------------------------------------------------------
+	//	Interface to bulk data and descriptor FIFOs
+	//--------------------------------------------------------------------------
+	input			bulkfifo_full;
+	output			bulkfifo_we;	// write enable to bulk data FIFO
+	output [63:0]		bulk_dout;	// data output to bulk data FIFO
+	output			bulkdesc_we;	// write enable to bulk descriptor FIFO
+	output [71:0]		bulk_desc;	// {good, seq[7:0], nwords[7:0], word address[54:0]}
+
 	output 			tx_send_ack;	// high for 2 cycles to signal TX block to send an ACK
-	output 			tx_credit_incr;	// high for 1 cycle when a TX credit token has been received
+	output 			tx_credit_incr;	// high for 1 cycle for each TX credit returned by the host
 	
 	output [47:0]		rx_source_mac;	// MAC address of source packets
+	output [7:0]		rx_host_caps;	// capabilities advertised in the last host ping
+	output			rx_host_udp;	// high if the last host ping came over UDP
+	output [31:0]		rx_source_ip;	// IP address of the last host to ping over UDP
+	output [15:0]		rx_source_port;	// UDP port of the last host to ping over UDP
 
-	output			rx_error;	// goes and stays high if any packet fails CRC check
-						// or if a data packet is received when the FIFO is full
+	output			rx_error;	// goes and stays high if any packet fails CRC check,
+						// if a data packet is received when the FIFO is full
+						// or if a cut-through data packet is cut short
+						// or a compressed packet has a bad group header
 
-	localparam 		STATE_Idle = 		3'b000,
-				STATE_Header = 		3'b001,
-				STATE_Data = 		3'b010,
-				STATE_Framecheck = 	3'b011,
-				STATE_Waiting = 	3'b100,
-				STATE_Token = 		3'b101,
-				STATE_Ping = 		3'b110;
+	localparam 		STATE_Idle = 		4'b0000,
+				STATE_Header = 		4'b0001,
+				STATE_Data = 		4'b0010,
+				STATE_Framecheck = 	4'b0011,
+				STATE_Waiting = 	4'b0100,
+				STATE_Token = 		4'b0101,
+				STATE_Ping = 		4'b0110,
+				STATE_CHeader = 	4'b0111,
+				STATE_CData = 		4'b1000,
+				STATE_CFramecheck = 	4'b1001,
+				STATE_BHeader = 	4'b1010,
+				STATE_BData = 		4'b1011,
+				STATE_BFramecheck = 	4'b1100,
+				STATE_Credit =		4'b1101,
+				STATE_UDPHeader =	4'b1110;
 
 	localparam		DestAddrLoc = 		5,
 				EtherTypeLoc = 		13,
 				PayloadStartLoc = 	15,
 				PayloadEndLoc = 	23,
+				CapsLoc = 		16,
+				CreditLoc =		17,
+				CreditEndLoc =		23,
+				CHeaderEndLoc = 	19,
+				BCountLoc = 		19,
+				BHeaderEndLoc = 	31,
+				IPVersionLoc =		14,
+				IPFragmentLoc =		21,
+				IPProtocolLoc =		23,
+				IPSourceLoc =		29,
+				IPDestLoc =		33,
+				UDPSourceLoc =		35,
+				UDPDestLoc =		37,
+				UDPHeaderEndLoc =	41,
+				BulkMaxWords = 		128,
 				RAMPEtherType = 	16'h8888,
+				IPEtherType =		16'h0800,
+				IPVersionIHL =		8'h45,
+				UDPProtocol =		8'h11,
 				TokenType = 		16'hFFFF,
 				PingType = 		16'hFFFE,
 				DataType = 		16'h0008,
-				BroadcastAddress = 	48'hFFFFFFFFFFFF;
+				CreditFlag =		16'h4000,
+				CDataType = 		16'h0009,
+				BulkType = 		16'hFFFD,
+				BroadcastAddress = 	48'hFFFFFFFFFFFF,
+				CGroupSlots =		8,
+				CGroupMaxWords =	64,
+				HoldDepth =		8;
 
 	//--------------------------------------------------------------------------
 	//	Wires & Regs
 	//--------------------------------------------------------------------------
 
-	reg [2:0] 		state, nstate;
+	reg [3:0] 		state, nstate;
 	reg [63:0] 		rx_data;
-	reg [4:0] 		rxcount;
+	reg [10:0] 		rxcount;
 	reg			rxcount_rst;
 	reg 			rx_done;
 	reg 			store_mac;
@@ -139,18 +223,91 @@ module EthernetFIFORx (
 	reg [47:0]		source_mac_reg;
 	reg			rxfifo_we_reg;
 	reg			rx_error_reg;
-	reg			tx_credit_incr_reg;
+	reg			store_caps;
+	reg [7:0]		host_caps_pending;
+	reg [7:0]		host_caps_reg;
+
+	//	Data packet capture (a data packet's type is its length in bytes)
+	reg			store_dcount, rx_abort;
+	reg [7:0]		rx_nwords;
+	reg [7:0]		rx_words;
+	reg [15:0]		rx_stall;
+	wire			data_type, rx_stalled;
+
+	//	UDP encapsulation: the IP and UDP headers are checked and skipped, and
+	//	the sender's addresses only replace the current host's once a ping
+	//	from it passes CRC check
+	reg			store_udp_mac, store_udp_ip, store_udp_port, udp_rewind;
+	reg			rx_udp;
+	reg [47:0]		udp_mac_pending;
+	reg [31:0]		udp_ip_pending, source_ip_reg;
+	reg [15:0]		udp_port_pending, source_port_reg;
+	reg			host_udp_reg;
+
+	//	Returned credit (from a token, or from the credit word of a data
+	//	packet) is counted while the frame arrives, and committed once it
+	//	passes CRC check
+	reg			start_credit, store_credit, store_credit_next, credit_commit;
+	reg			rxcount_rewind;
+	reg [3:0]		credit_next, credit_target;
+	reg [15:0]		credit_count;
+	reg [15:0]		credit_pending;
+	wire [15:0]		rx_type;
+	wire			credit_flag;
+
+	//	Cut-through words that arrive while a compressed packet is still being
+	//	expanded are held back here so that they stay in order
+	reg [63:0]		hold_data [0:HoldDepth-1];
+	reg [2:0]		hold_head, hold_tail;
+	reg [3:0]		hold_count;
+	wire			hold_we, hold_re, word_we;
+
+	//	Compressed packet capture (written while the frame arrives)
+	reg			store_cheader, store_cword, cframe_good;
+	reg [3:0]		cgroup_slots;
+	reg [7:0]		cgroup_bitmap;
+	reg [7:0]		cgroup_repeat;
+	reg [3:0]		cgroup_lit;
+	reg [63:0]		cgroup_data [0:7];
+	wire [3:0]		cgroup_nlit;
+	wire			cheader_bad;
+
+	//	Bulk packet capture (data words go straight to the bulk data FIFO, and
+	//	a descriptor follows once the frame has been checked)
+	reg			store_bcount, store_baddr;
+	reg			bulkfifo_we_reg, bulkdesc_we_reg, bulk_good, bulk_reject;
+	reg [15:0]		bulk_nwords;
+	reg [7:0]		bulk_seq;
+	reg [7:0]		bulk_count;
+	reg [54:0]		bulk_waddr;
+
+	//	Compressed packet expansion (runs once the frame passes CRC check)
+	reg			exp_active;
+	reg [3:0]		exp_slot, exp_slots, exp_lit;
+	reg [7:0]		exp_bitmap;
+	reg [7:0]		exp_repeat;
+	reg [63:0]		exp_word;
+	wire [63:0]		exp_dout;
+	wire			exp_we;
 
 	//--------------------------------------------------------------------------
 	//	Assigns
 	//--------------------------------------------------------------------------
 
-	assign rx_dout = 	rx_data;
+	assign rx_dout = 	exp_active ? exp_dout : hold_re ? hold_data[hold_tail] : rx_data;
 	assign tx_send_ack = 	|send_ack_reg;
 	assign rx_source_mac = 	source_mac_reg;
-	assign rxfifo_we = 	rxfifo_we_reg;
+	assign rx_host_caps =	host_caps_reg;
+	assign rx_host_udp =	host_udp_reg;
+	assign rx_source_ip =	source_ip_reg;
+	assign rx_source_port =	source_port_reg;
+	assign rxfifo_we = 	word_we | hold_re | exp_we;
 	assign rx_error = 	rx_error_reg;
-	assign tx_credit_incr = tx_credit_incr_reg;
+	assign bulkfifo_we =	bulkfifo_we_reg;
+	assign bulk_dout =	rx_data;
+	assign bulkdesc_we =	bulkdesc_we_reg;
+	assign bulk_desc =	{bulk_good, bulk_seq, bulk_count, bulk_waddr};
+	assign tx_credit_incr = (credit_pending != 16'h0000);
 	assign rx_source_mac = 	source_mac_reg;
 
 	//--------------------------------------------------------------------------
@@ -162,9 +319,29 @@ module EthernetFIFORx (
 		rxfifo_we_reg = 1'b0;
 		rxcount_rst = 1'b0;
 		rx_done = 1'b0;
-		tx_credit_incr_reg = 1'b0;
+		start_credit = 1'b0;
+		store_credit = 1'b0;
+		store_credit_next = 1'b0;
+		credit_commit = 1'b0;
+		credit_target = STATE_Waiting;
+		rxcount_rewind = 1'b0;
+		store_udp_mac = 1'b0;
+		store_udp_ip = 1'b0;
+		store_udp_port = 1'b0;
+		udp_rewind = 1'b0;
 		store_mac = 1'b0;
 		ack = 1'b0;
+		store_caps = 1'b0;
+		store_dcount = 1'b0;
+		rx_abort = 1'b0;
+		store_cheader = 1'b0;
+		store_cword = 1'b0;
+		cframe_good = 1'b0;
+		store_bcount = 1'b0;
+		store_baddr = 1'b0;
+		bulkfifo_we_reg = 1'b0;
+		bulkdesc_we_reg = 1'b0;
+		bulk_good = 1'b0;
 
 		case (state)
 			STATE_Idle : begin
@@ -177,24 +354,95 @@ module EthernetFIFORx (
 				    rx_data[47:0] != BroadcastAddress))
 					nstate = STATE_Waiting;
 				if (rxcount == EtherTypeLoc) begin
-					if (rx_data[15:0] != RAMPEtherType)
-						nstate = STATE_Waiting;
-					else
+					if (rx_data[15:0] == RAMPEtherType)
 						store_mac = 1'b1;
+					else if (UDPEnable && rx_data[15:0] == IPEtherType) begin
+						store_udp_mac = 1'b1;
+						nstate = STATE_UDPHeader;
+					end
+					else
+						nstate = STATE_Waiting;
 					end
 				if (rxcount == PayloadStartLoc) begin
-					if (rx_data[15:0] == TokenType)
+					start_credit = 1'b1;
+					if (rx_type == TokenType)
 						nstate = STATE_Token;
-					else if (rx_data[15:0] == DataType)
+					else if (data_type) begin
+						store_dcount = 1'b1;
 						nstate = STATE_Data;
-					else if (rx_data[15:0] == PingType)
+					end
+					else if (rx_type == PingType)
 						nstate = STATE_Ping;
+					else if (CompressEnable && rx_type == CDataType)
+						nstate = STATE_CHeader;
+					else if (BulkEnable && rx_type == BulkType)
+						nstate = STATE_BHeader;
 					else
 						nstate = STATE_Waiting;
+					// a data packet carrying credit has a credit word first
+					if (credit_flag) begin
+						store_credit_next = 1'b1;
+						credit_target = nstate;
+						if (nstate == STATE_Data | nstate == STATE_CHeader)
+							nstate = STATE_Credit;
+						else
+							nstate = STATE_Waiting;
 					end
+					end
+				end
+			STATE_UDPHeader : begin
+				// only unfragmented datagrams without IP options are taken,
+				// and checksums are left to the ethernet CRC; at the end of
+				// the UDP header rxcount is wound back so the packet type
+				// is found where it would be in a raw frame
+				if (rxcount == IPVersionLoc & rx_data[7:0] != IPVersionIHL)
+					nstate = STATE_Waiting;
+				if (rxcount == IPFragmentLoc & rx_data[13:0] != 14'h0000)
+					nstate = STATE_Waiting;
+				if (rxcount == IPProtocolLoc & rx_data[7:0] != UDPProtocol)
+					nstate = STATE_Waiting;
+				if (rxcount == IPSourceLoc)
+					store_udp_ip = 1'b1;
+				if (rxcount == IPDestLoc & rx_data[31:0] != IPAddress)
+					nstate = STATE_Waiting;
+				if (rxcount == UDPSourceLoc)
+					store_udp_port = 1'b1;
+				if (rxcount == UDPDestLoc & rx_data[15:0] != UDPPort)
+					nstate = STATE_Waiting;
+				if (rxcount == UDPHeaderEndLoc) begin
+					udp_rewind = 1'b1;
+					nstate = STATE_Header;
+				end
+			end
+			STATE_Credit : begin
+				// the count is in the first two bytes of the credit word; at
+				// its end rxcount is wound back so the payload that follows
+				// is found where it would be without one
+				if (rxcount == CreditLoc)
+					store_credit = 1'b1;
+				if (rx_good_frame | rx_bad_frame)
+					nstate = STATE_Idle;
+				else if (rxcount == CreditEndLoc) begin
+					rxcount_rewind = 1'b1;
+					nstate = credit_next;
 				end
+			end
 			STATE_Data : begin
-				if (rxcount == PayloadEndLoc) begin
+				if (CutThrough) begin
+					// a data word is complete every 8 bytes after the header
+					// and is written straight away; if the frame ends early
+					// the packet is abandoned
+					if (rx_good_frame | rx_bad_frame | rx_stalled) begin
+						rx_abort = 1'b1;
+						nstate = STATE_Idle;
+					end
+					else if (rxcount[2:0] == 3'b111) begin
+						rxfifo_we_reg = 1'b1;
+						if (rx_words + 1 == rx_nwords)
+							nstate = STATE_Framecheck;
+					end
+				end
+				else if (rxcount == PayloadEndLoc) begin
 					nstate = STATE_Framecheck;
 					rx_done = 1'b1;
 				end
@@ -202,21 +450,95 @@ module EthernetFIFORx (
 			STATE_Framecheck : begin
 				rx_done = 1'b1;
 				if (rx_good_frame) begin
-					rxfifo_we_reg = 1'b1;
+					rxfifo_we_reg = ~CutThrough;
+					credit_commit = 1'b1;
 					nstate = STATE_Idle;
 				end
 				if (rx_bad_frame)
 					nstate = STATE_Idle;
+				if (rx_stalled) begin
+					rx_abort = 1'b1;
+					nstate = STATE_Idle;
+				end
 			end
 			STATE_Token : begin
+				// a counted token from a host using credit words
+				if (rxcount == CreditLoc & host_caps_reg[3] & rx_data[15:0] != 16'h0000)
+					store_credit = 1'b1;
 				if (rx_good_frame) begin
-					tx_credit_incr_reg = 1'b1;
+					credit_commit = 1'b1;
 					nstate = STATE_Idle;
 				end
 				if (rx_bad_frame)
 					nstate = STATE_Idle;
 			end
+			STATE_CHeader : begin
+				// a group with no slots, or one that expands to more words
+				// than the hold queue is sized for, is dropped
+				if (rxcount == CHeaderEndLoc) begin
+					store_cheader = 1'b1;
+					if (cheader_bad)
+						nstate = STATE_Waiting;
+					else if (rx_data[23:16] == 8'h00)
+						nstate = STATE_CFramecheck;
+					else
+						nstate = STATE_CData;
+				end
+			end
+			STATE_CData : begin
+				// a literal word is complete every 8 bytes after the group header
+				if (rxcount[2:0] == 3'b011) begin
+					store_cword = 1'b1;
+					if (cgroup_lit + 1 == cgroup_nlit)
+						nstate = STATE_CFramecheck;
+				end
+			end
+			STATE_CFramecheck : begin
+				if (rx_good_frame) begin
+					cframe_good = 1'b1;
+					credit_commit = 1'b1;
+					nstate = STATE_Idle;
+				end
+				if (rx_bad_frame)
+					nstate = STATE_Idle;
+			end
+			STATE_BHeader : begin
+				if (rxcount == BCountLoc)
+					store_bcount = 1'b1;
+				// a packet with a bad word count is not written, but is still
+				// described (with no words) so that it gets a failure ack
+				if (rxcount == BHeaderEndLoc) begin
+					store_baddr = 1'b1;
+					if (bulk_nwords == 16'h0000 | bulk_nwords > BulkMaxWords)
+						nstate = STATE_BFramecheck;
+					else
+						nstate = STATE_BData;
+				end
+			end
+			STATE_BData : begin
+				// a data word is complete every 8 bytes after the bulk header;
+				// if the frame ends early, the words already written are
+				// described as bad so that they get discarded
+				if (rx_good_frame | rx_bad_frame) begin
+					bulkdesc_we_reg = 1'b1;
+					nstate = STATE_Idle;
+				end
+				else if (rxcount[2:0] == 3'b111) begin
+					bulkfifo_we_reg = 1'b1;
+					if (bulk_count + 1 == bulk_nwords)
+						nstate = STATE_BFramecheck;
+				end
+			end
+			STATE_BFramecheck : begin
+				if (rx_good_frame | rx_bad_frame) begin
+					bulk_good = rx_good_frame & ~bulk_reject;
+					bulkdesc_we_reg = 1'b1;
+					nstate = STATE_Idle;
+				end
+			end
 			STATE_Ping: begin
+				if (rxcount == CapsLoc)
+					store_caps = 1'b1;
 				if (rx_good_frame) begin
 					ack = 1'b1;
 					nstate = STATE_Idle;
@@ -230,6 +552,132 @@ module EthernetFIFORx (
 		  endcase	
 	end
 
+	//--------------------------------------------------------------------------
+	//	Data packet framing
+	//
+	//	Without cut-through only single word packets are accepted, and the word
+	//	is written once the CRC check passes.  The stall counter starts once
+	//	the data stops and is cleared by the MAC's frame status.
+	//--------------------------------------------------------------------------
+
+	assign data_type =	(rx_type[2:0] == 3'b000) & (rx_type[15:3] != 13'h0000) &
+				(rx_type[15:3] <= (CutThrough ? MaxFrameWords : 1));
+	assign rx_stalled =	(RxFillTimeout != 0) & (rx_stall == RxFillTimeout);
+
+	always @ (posedge clk) begin
+		if (store_dcount) begin
+			rx_nwords <= rx_data[10:3];
+			rx_words <= 8'h00;
+		end
+		else if (rxfifo_we_reg)
+			rx_words <= rx_words + 1;
+
+		if ((state != STATE_Data & state != STATE_Framecheck) | rxdv)
+			rx_stall <= 16'h0000;
+		else
+			rx_stall <= rx_stall + 1;
+	end
+
+	//--------------------------------------------------------------------------
+	//	Returned credit
+	//
+	//	The TX credit semaphore only moves by one per cycle, so credit is
+	//	handed over from credit_pending one at a time.  A token carries 1
+	//	credit unless it holds a count, and a data packet none unless it has
+	//	a credit word.
+	//--------------------------------------------------------------------------
+
+	assign credit_flag =	CreditEnable & (rx_data[15:14] == 2'b01);
+	assign rx_type =	credit_flag ? (rx_data[15:0] & ~CreditFlag) : rx_data[15:0];
+
+	always @ (posedge clk) begin
+		if (start_credit)
+			credit_count <= {15'h0000, rx_type == TokenType};
+		else if (store_credit)
+			credit_count <= rx_data[15:0];
+
+		if (store_credit_next)
+			credit_next <= credit_target;
+
+		if (reset)
+			credit_pending <= 16'h0000;
+		else
+			credit_pending <= credit_pending + (credit_commit ? credit_count : 16'h0000) -
+					  (credit_pending != 16'h0000);
+	end
+
+	//--------------------------------------------------------------------------
+	//	Cut-through hold queue
+	//
+	//	An expansion lasts at most 64 cycles, and at most 3 words of the next
+	//	packet can arrive in that time, so the queue never fills and is always
+	//	empty again long before the next compressed packet finishes.
+	//--------------------------------------------------------------------------
+
+	assign hold_we =	rxfifo_we_reg & (exp_active | hold_count != 4'h0);
+	assign hold_re =	~exp_active & (hold_count != 4'h0);
+	assign word_we =	rxfifo_we_reg & ~hold_we;
+
+	always @ (posedge clk) begin
+		if (reset) begin
+			hold_head <= 3'b000;
+			hold_tail <= 3'b000;
+			hold_count <= 4'h0;
+		end
+		else begin
+			if (hold_we) begin
+				hold_data[hold_head] <= rx_data;
+				hold_head <= hold_head + 1;
+			end
+			if (hold_re)
+				hold_tail <= hold_tail + 1;
+			hold_count <= hold_count + hold_we - hold_re;
+		end
+	end
+
+	//--------------------------------------------------------------------------
+	//	Compressed packet expansion
+	//
+	//	Slots are consumed from cgroup_data within the first 8 cycles after
+	//	the CRC check, well before the next frame can overwrite them, and a
+	//	group header promising 0 or more than 8 slots, or more than 64 words
+	//	in all, is dropped in STATE_CHeader, so expansion always finishes
+	//	before the next minimum-sized frame has been received.
+	//--------------------------------------------------------------------------
+
+	assign cheader_bad =	(rx_data[31:24] == 8'h00) | (rx_data[31:24] > CGroupSlots) |
+				({1'b0, rx_data[31:24]} + {1'b0, rx_data[15:8]} > CGroupMaxWords);
+	assign cgroup_nlit =	cgroup_bitmap[7] + cgroup_bitmap[6] + cgroup_bitmap[5] + cgroup_bitmap[4] +
+				cgroup_bitmap[3] + cgroup_bitmap[2] + cgroup_bitmap[1] + cgroup_bitmap[0];
+	assign exp_dout =	(exp_slot == exp_slots) ? exp_word :
+				exp_bitmap[7] ? cgroup_data[exp_lit] : {64{1'b0}};
+	assign exp_we =		exp_active & ((exp_slot != exp_slots) | (exp_repeat != 8'h00));
+
+	always @ (posedge clk) begin
+		if (reset)
+			exp_active <= 1'b0;
+		else if (cframe_good)
+			exp_active <= 1'b1;
+		else if (exp_slot == exp_slots & exp_repeat == 8'h00)
+			exp_active <= 1'b0;
+
+		if (cframe_good) begin
+			exp_slot <= 4'h0;
+			exp_slots <= cgroup_slots;
+			exp_lit <= 4'h0;
+			exp_bitmap <= cgroup_bitmap;
+			exp_repeat <= cgroup_repeat;
+		end
+		else if (exp_active & exp_slot != exp_slots) begin
+			exp_slot <= exp_slot + 1;
+			exp_lit <= exp_lit + exp_bitmap[7];
+			exp_bitmap <= {exp_bitmap[6:0], 1'b0};
+			exp_word <= exp_dout;
+		end
+		else if (exp_active & exp_repeat != 8'h00)
+			exp_repeat <= exp_repeat - 1;
+	end
+
 	//--------------------------------------------------------------------------
 	//	Registers
 	//--------------------------------------------------------------------------
@@ -246,24 +694,87 @@ module EthernetFIFORx (
 			rx_data <= {rx_data[55:0], rxd};
 
 		if (rxcount_rst) 
-			rxcount <= {5{1'b0}};
+			rxcount <= {11{1'b0}};
+		else if (rxcount_rewind)
+			rxcount <= PayloadStartLoc + 1;
+		else if (udp_rewind)
+			rxcount <= EtherTypeLoc + 1;
 		else 
 			rxcount <= rxcount + 1;
 		
 		if (reset) 
 			rx_error_reg <= 1'b0;
-		else if (rx_bad_frame | (rxfifo_we_reg & rxfifo_full)) 
+		else if (rx_bad_frame | rx_abort | (rxfifo_we & rxfifo_full) | (bulkfifo_we_reg & bulkfifo_full) |
+			 (hold_we & hold_count == HoldDepth) | (store_cheader & cheader_bad)) 
 			rx_error_reg <= 1'b1;
   
 		if (reset) 
 			source_mac_reg <= {48{1'b1}};
 		else if (store_mac) 
 			source_mac_reg <= rx_data[63:16];
+		else if (ack & rx_udp)
+			source_mac_reg <= udp_mac_pending;
+
+		if (store_udp_mac)
+			udp_mac_pending <= rx_data[63:16];
+		if (store_udp_ip)
+			udp_ip_pending <= rx_data[31:0];
+		if (store_udp_port)
+			udp_port_pending <= rx_data[15:0];
+
+		if (rxcount_rst)
+			rx_udp <= 1'b0;
+		else if (udp_rewind)
+			rx_udp <= 1'b1;
+
+		// replies go back the way the last ping came
+		if (reset)
+			host_udp_reg <= 1'b0;
+		else if (ack)
+			host_udp_reg <= rx_udp;
+
+		if (ack & rx_udp) begin
+			source_ip_reg <= udp_ip_pending;
+			source_port_reg <= udp_port_pending;
+		end
   
 		if (reset) 
 			send_ack_reg <= 2'b00;
 		else 
 			send_ack_reg <= {send_ack_reg[0], ack};  
+
+		// host capabilities are only committed once the ping passes CRC check
+		if (store_caps)
+			host_caps_pending <= rx_data[7:0];
+
+		if (reset)
+			host_caps_reg <= 8'h00;
+		else if (ack)
+			host_caps_reg <= host_caps_pending;
+
+		if (store_bcount) begin
+			bulk_nwords <= rx_data[31:16];
+			bulk_seq <= rx_data[15:8];
+		end
+
+		if (store_baddr) begin
+			bulk_waddr <= rx_data[57:3];
+			bulk_count <= 8'h00;
+			bulk_reject <= (bulk_nwords == 16'h0000 | bulk_nwords > BulkMaxWords);
+		end
+		else if (bulkfifo_we_reg)
+			bulk_count <= bulk_count + 1;
+
+		if (store_cheader) begin
+			cgroup_slots <= rx_data[27:24];
+			cgroup_bitmap <= rx_data[23:16];
+			cgroup_repeat <= rx_data[15:8];
+			cgroup_lit <= 4'h0;
+		end
+		else if (store_cword) begin
+			cgroup_data[cgroup_lit] <= rx_data;
+			cgroup_lit <= cgroup_lit + 1;
+		end
 	end
 
 endmodule
@@ -0,0 +1,186 @@
+//==============================================================================
+//	Section:	License
+//==============================================================================
+//	Copyright (c) 2005-2009, Regents of the University of California
+//	All rights reserved.
+//
+//	Redistribution and use in source and binary forms, with or without modification,
+//	are permitted provided that the following conditions are met:
+//
+//		- Redistributions of source code must retain the above copyright notice,
+//			this list of conditions and the following disclaimer.
+//		- Redistributions in binary form must reproduce the above copyright
+//			notice, this list of conditions and the following disclaimer
+//			in the documentation and/or other materials provided with the
+//			distribution.
+//		- Neither the name of the University of California, Berkeley nor the
+//			names of its contributors may be used to endorse or promote
+//			products derived from this software without specific prior
+//			written permission.
+//
+//	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+//	ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+//	ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+//------------------------------------------------------------------------------
+//	Module:		EthernetFIFOSpill
+//	Description:	This module moves words from the RX FIFO to the output
+//			FIFO, spilling them into a ring buffer in DDR2 whenever
+//			the output FIFO is full or earlier words are still in
+//			DDR2, and reading them back in order as the output FIFO
+//			drains.  Memory requests are presented to the user, who
+//			dequeues them as DDR2 accepts them and returns read data
+//			in request order.
+//			
+//	Parameters:	SpillBase:		DDR2 byte address of the ring buffer
+//			SpillAWidth:		log2 of the ring buffer size in words
+//
+//	Version:	
+//------------------------------------------------------------------------------
+
+module EthernetFIFOSpill(
+			//------------------------------------------------------------------
+			//	System Inputs
+			//------------------------------------------------------------------
+			clk,
+			reset,
+			//------------------------------------------------------------------
+			//	Interface to RX FIFO (first word fall through)
+			//------------------------------------------------------------------
+			rxfifo_empty,
+			rxfifo_re,
+			rxfifo_data,
+			//------------------------------------------------------------------
+			//	Interface to output FIFO
+			//------------------------------------------------------------------
+			outfifo_we,
+			outfifo_data,
+			outfifo_re,
+			//------------------------------------------------------------------
+			//	DDR2 request interface
+			//------------------------------------------------------------------
+			spill_wr_addr,
+			spill_wr_data,
+			spill_wr_valid,
+			spill_wr_deq,
+			spill_rd_addr,
+			spill_rd_valid,
+			spill_rd_deq,
+			spill_rsp_data,
+			spill_rsp_valid
+	);
+
+	//--------------------------------------------------------------------------
+	//	Parameters
+	//--------------------------------------------------------------------------
+
+	parameter		SpillBase =	64'h0000000000000000;
+	parameter		SpillAWidth =	15;
+
+	//--------------------------------------------------------------------------
+	//	System inputs
+	//--------------------------------------------------------------------------
+
+	input			clk;
+	input			reset;
+
+	//--------------------------------------------------------------------------
+	//	Interface to RX FIFO
+	//--------------------------------------------------------------------------
+
+	input			rxfifo_empty;
+	output			rxfifo_re;
+	input [63:0]		rxfifo_data;
+
+	//--------------------------------------------------------------------------
+	//	Interface to output FIFO
+	//--------------------------------------------------------------------------
+
+	output			outfifo_we;
+	output [63:0]		outfifo_data;
+	input			outfifo_re;		// user dequeue, used to track occupancy
+
+	//--------------------------------------------------------------------------
+	//	DDR2 request interface
+	//--------------------------------------------------------------------------
+
+	output [63:0]		spill_wr_addr;
+	output [63:0]		spill_wr_data;
+	output			spill_wr_valid;
+	input			spill_wr_deq;
+	output [63:0]		spill_rd_addr;
+	output			spill_rd_valid;
+	input			spill_rd_deq;
+	input [63:0]		spill_rsp_data;
+	input			spill_rsp_valid;
+
+	//--------------------------------------------------------------------------
+	//	Constants
+	//--------------------------------------------------------------------------
+
+	localparam		OutDepth =	512;
+
+	//--------------------------------------------------------------------------
+	//	Wires & Regs
+	//--------------------------------------------------------------------------
+
+	reg [SpillAWidth-1:0]	wr_ptr, rd_ptr;
+	reg [SpillAWidth:0]	spilled;		// words in DDR2 not yet requested back
+	reg [9:0]		outstanding;		// words in the output FIFO plus reads in flight
+	reg [9:0]		occupied;		// words in the output FIFO
+
+	wire			bypass, out_room;
+
+	//--------------------------------------------------------------------------
+	//	Assigns
+	//--------------------------------------------------------------------------
+
+	// words may only skip DDR2 while nothing is waiting there or on its way
+	// back, i.e. while no reads are in flight (outstanding == occupied)
+	assign	out_room =	(outstanding < OutDepth);
+	assign	bypass =	~rxfifo_empty & out_room & (spilled == 0) & (outstanding == occupied);
+
+	assign	spill_wr_valid = ~rxfifo_empty & ~bypass & (spilled != (1 << SpillAWidth));
+	assign	spill_wr_addr =	SpillBase + {wr_ptr, 3'b000};
+	assign	spill_wr_data =	rxfifo_data;
+
+	assign	spill_rd_valid = (spilled != 0) & out_room;
+	assign	spill_rd_addr =	SpillBase + {rd_ptr, 3'b000};
+
+	assign	rxfifo_re =	bypass | spill_wr_deq;
+	assign	outfifo_we =	bypass | spill_rsp_valid;
+	assign	outfifo_data =	bypass ? rxfifo_data : spill_rsp_data;
+
+	//--------------------------------------------------------------------------
+	//	Registers
+	//--------------------------------------------------------------------------
+
+	always @ (posedge clk) begin
+		if (reset) begin
+			wr_ptr <= 0;
+			rd_ptr <= 0;
+			spilled <= 0;
+			outstanding <= 0;
+			occupied <= 0;
+		end
+		else begin
+			if (spill_wr_deq)
+				wr_ptr <= wr_ptr + 1;
+			if (spill_rd_deq)
+				rd_ptr <= rd_ptr + 1;
+
+			spilled <= spilled + spill_wr_deq - spill_rd_deq;
+			outstanding <= outstanding + (bypass | spill_rd_deq) - outfifo_re;
+			occupied <= occupied + outfifo_we - outfifo_re;
+		end
+	end
+
+endmodule
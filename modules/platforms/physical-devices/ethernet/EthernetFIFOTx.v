@@ -36,6 +36,25 @@
 //			of the EthernetFIFO interface
 //			
 //	Parameters:	MACAddress:		The hardware MAC address assigned to this device
+//			CompressEnable:		Send compressed data packets to hosts that
+//						advertise support for them, for groups of
+//						words that compression shrinks
+//			BulkEnable:		Advertise support for bulk data packets
+//			RxWindow:		Receive credit window (in words) advertised
+//						to the host in ping responses
+//			CutThrough:		Advertise support for multi-word data packets
+//			TxFrameWords:		Largest multi-word data packet sent (in words) to
+//						hosts that advertise support for them
+//			TxFillTimeout:		Cycles to wait for a data packet to fill up before
+//						asking the MAC to start sending it (0 to start
+//						as soon as there is a word to send)
+//			CreditEnable:		Return RX credit in a credit word on outgoing
+//						data packets, and send counted tokens, to hosts
+//						that advertise support for them
+//			IPAddress:		The IPv4 address assigned to this device
+//			UDPEnable:		Encapsulate packets in UDP/IPv4 for hosts that
+//						ping over UDP
+//			UDPPort:		UDP port of this device
 //
 //	Author:		Rimas Avizienis
 //	Version:	
@@ -67,7 +86,14 @@ module EthernetFIFOTx(
 			tx_send_token,
 			tx_send_ack,
 			rx_token_decr,
-			tx_dest_mac
+			tx_dest_mac,
+			tx_host_caps,
+			tx_host_udp,
+			tx_dest_ip,
+			tx_dest_port,
+			tx_send_bulk_ack,
+			tx_bulk_ack,
+			bulk_ack_re
 
 );
 
@@ -76,6 +102,16 @@ module EthernetFIFOTx(
 	//--------------------------------------------------------------------------
 
 	parameter		MACAddress = 	48'h112233445566;
+	parameter		CompressEnable = 1;
+	parameter		BulkEnable =	1;
+	parameter		RxWindow =	512;
+	parameter		CutThrough =	1;
+	parameter		TxFrameWords =	32;
+	parameter		TxFillTimeout =	0;
+	parameter		CreditEnable =	1;
+	parameter		IPAddress =	32'hC0A80A02;
+	parameter		UDPEnable =	1;
+	parameter		UDPPort =	16'h8888;
 
 	//--------------------------------------------------------------------------
 	//	System inputs
@@ -106,39 +142,108 @@ module EthernetFIFOTx(
 
 	input   		tx_credit_avail;	// high when there is TX credit available
 	output			tx_credit_decr;		// high to decrement TX credit count
-	input			tx_send_token;		// high when an RX credit token should be sent
+	input			tx_send_token;		// high when there is RX credit to return to the host
 	input			tx_send_ack;		// high when an ACK packet should be sent
 	input [47:0]		tx_dest_mac;		// destination MAC address
-	output 			rx_token_decr;		// high to decrement count of RX credit tokens to send
+	output 			rx_token_decr;		// high to move an RX credit into the token bank
+	input [7:0]		tx_host_caps;		// host capabilities (quasi-static, set by the RX side on a ping)
+	input			tx_host_udp;		// high to encapsulate packets in UDP (quasi-static, as above)
+	input [31:0]		tx_dest_ip;		// destination IP address for UDP packets
+	input [15:0]		tx_dest_port;		// destination UDP port
+	input			tx_send_bulk_ack;	// high when a bulk packet acknowledgement should be sent
+	input [8:0]		tx_bulk_ack;		// {status, seq[7:0]} of the bulk packet to acknowledge
+	output			bulk_ack_re;		// high to dequeue the bulk acknowledgement
 
 	//--------------------------------------------------------------------------
 	//	Constants
 	//--------------------------------------------------------------------------
 
-	localparam		STATE_Idle =	3'b000,
-				STATE_Start =	3'b001,
-				STATE_Header = 	3'b010,
-				STATE_Data = 	3'b011,
-				STATE_Token = 	3'b100,
-				STATE_Ack = 	3'b101;
+	localparam		STATE_Idle =	4'b0000,
+				STATE_Start =	4'b0001,
+				STATE_Header = 	4'b0010,
+				STATE_Data = 	4'b0011,
+				STATE_Token = 	4'b0100,
+				STATE_Ack = 	4'b0101,
+				STATE_Caps = 	4'b0110,
+				STATE_Gather = 	4'b0111,
+				STATE_CHeader =	4'b1000,
+				STATE_CData = 	4'b1001,
+				STATE_BulkAck =	4'b1010,
+				STATE_BulkAckData = 4'b1011,
+				STATE_Fill =	4'b1100,
+				STATE_Credit =	4'b1101,
+				STATE_IPHeader = 4'b1110;
+
+	localparam		LocalCaps =	{4'b0000, CreditEnable ? 1'b1 : 1'b0, CutThrough ? 1'b1 : 1'b0, BulkEnable ? 1'b1 : 1'b0, CompressEnable ? 1'b1 : 1'b0},
+				IPHeaderLen =	28,
+				IPTimeToLive =	8'h40,
+				GroupSlots = 	8,
+				GroupMaxWords =	64;
 
 	//--------------------------------------------------------------------------
 	//	Wires & Regs
 	//--------------------------------------------------------------------------
 
-	reg [2:0]		state, nstate;
+	reg [3:0]		state, nstate;
 
 	reg			txcount_rst; 
 	reg [3:0]		txcount;
-	reg [2:0]		tx_sel;
+	reg [3:0]		tx_sel;
 
 	reg [7:0]		fifo_data, tx_data, mac_data, rom_data;
+	reg [7:0]		cheader_data, lit_data, window_data, credit_data, ip_data;
 	reg [1:0]		send_ack_reg;	
 	reg			send_ack, clear_ack;
 	
 	reg			txfifo_re_reg;
-	reg			rx_token_decr_reg;
 	reg			txen_reg;
+	reg			bulk_ack_re_reg;
+
+	//	Compressed packet gathering
+	reg [3:0]		gather_slots;
+	reg [7:0]		gather_repeat;
+	reg [7:0]		gather_bitmap;
+	reg [3:0]		gather_nlit;
+	reg			gather_rpt;
+	reg [63:0]		gather_last;
+	reg [63:0]		tx_lit [0:7];
+	reg [3:0]		lit_idx;
+	wire			tx_compress, cframe;
+	wire			gather_avail, gather_match, gather_take, gather_plain;
+
+	//	Returned RX credit is banked here until it goes out, either in the
+	//	credit word of a data packet or in a token
+	reg [15:0]		token_bank;
+	reg [15:0]		credit_field;
+	reg			credit_word;
+	reg			credit_take;
+	wire [15:0]		credit_amount;
+	wire			piggyback, token_pending;
+
+	//	UDP encapsulation: the IP and UDP headers go between the ethertype and
+	//	the packet type, while txcount holds, and the state that would have
+	//	followed the ethertype is kept until they are done
+	reg [4:0]		ip_count;
+	reg [3:0]		ip_next;
+	reg			txcount_hold, ip_load;
+	reg [3:0]		ip_choice;
+	wire			tx_udp;
+	wire [15:0]		udp_len, ip_len;
+	wire [19:0]		ip_sum;
+	wire [16:0]		ip_fold;
+	wire [15:0]		ip_csum;
+
+	//	Data packet filling (words are pulled from the TX FIFO until the
+	//	packet length goes out in the header, even once the frame has started)
+	reg [63:0]		tx_buf [0:TxFrameWords-1];
+	reg [7:0]		fill_count;
+	reg [7:0]		buf_idx;
+	reg [15:0]		fill_timer;
+	reg			dframe;
+	wire [7:0]		fill_max;
+	wire			fill_open, fill_take, buf_we;
+	wire [7:0]		buf_waddr;
+	wire [15:0]		frame_bytes;
 
 	//--------------------------------------------------------------------------
 	//	Assigns
@@ -146,9 +251,59 @@ module EthernetFIFOTx(
 
 	assign	txd = 		tx_data;
 	assign	txen = 		txen_reg;	
-	assign	txfifo_re = 	txfifo_re_reg;
-	assign	rx_token_decr = rx_token_decr_reg;
-	assign	tx_credit_decr = txfifo_re_reg;
+	assign	txfifo_re = 	txfifo_re_reg | fill_take;
+	assign	rx_token_decr = tx_send_token & (token_bank != 16'hFFFF);
+	assign	tx_credit_decr = txfifo_re;
+	assign	bulk_ack_re =	bulk_ack_re_reg;
+
+	assign	tx_compress =	CompressEnable & tx_host_caps[0];
+	assign	cframe =	(gather_slots != 4'h0);
+
+	//	With credit words, a token is only sent when there is no data packet
+	//	about to go out that could carry the credit instead, and then returns
+	//	everything in the bank.  Otherwise each token returns a single credit.
+	assign	piggyback =	CreditEnable & tx_host_caps[3];
+	assign	token_pending =	(token_bank != 16'h0000) & (~piggyback | txfifo_empty | ~tx_credit_avail);
+	assign	credit_amount =	piggyback ? token_bank : 16'h0001;
+
+	//	The lengths are worked out from the packet that follows, which is
+	//	fixed by the time the IP header starts.  The UDP checksum is left
+	//	out (zero), as IPv4 allows.
+	assign	tx_udp =	UDPEnable & tx_host_udp;
+	assign	udp_len =	16'd10 + (credit_word ? 16'd8 : 16'd0) +
+				((ip_next == STATE_Ack) ? 16'd5 :
+				 (ip_next == STATE_BulkAck) ? 16'd2 :
+				 (ip_next == STATE_Token) ? 16'd0 :
+				 cframe ? {9'h000, gather_nlit, 3'b000} + 16'd4 : frame_bytes);
+	assign	ip_len =	udp_len + 16'd20;
+	assign	ip_sum =	16'h4500 + ip_len + 16'h4000 + {IPTimeToLive, 8'h11} +
+				IPAddress[31:16] + IPAddress[15:0] + tx_dest_ip[31:16] + tx_dest_ip[15:0];
+	assign	ip_fold =	ip_sum[15:0] + ip_sum[19:16];
+	assign	ip_csum =	~(ip_fold[15:0] + ip_fold[16]);
+
+	//	Slots are filled until a word repeats its predecessor, after which
+	//	only further repeats of that word are taken (matches ramp_fifo.c).
+	assign	gather_avail =	~txfifo_empty & tx_credit_avail & (gather_slots + gather_repeat < GroupMaxWords);
+	assign	gather_match =	cframe & (txfifo_data == gather_last);
+	assign	gather_take =	gather_avail & (gather_match | (~gather_rpt & gather_slots != GroupSlots));
+
+	//	A group that compression would not shrink (no zero words and no
+	//	repeats) is sent as a data packet instead, if it fits in one.  Its
+	//	words are kept in tx_buf as they are gathered, and the packet goes
+	//	on filling like any other.
+	assign	gather_plain =	(state == STATE_Gather) & ~gather_take & ~gather_rpt & (gather_slots != 4'h0) &
+				(gather_nlit == gather_slots) & ({4'h0, gather_slots} <= fill_max);
+
+	//	The length is sent at txcount 14 and 15, so the last word can be
+	//	taken at txcount 13.  Hosts that do not take multi-word packets get
+	//	one word per packet.
+	assign	fill_max =	(CutThrough & tx_host_caps[2]) ? TxFrameWords : 1;
+	assign	fill_open =	(state == STATE_Fill) |
+				(dframe & (state == STATE_Start | (state == STATE_Header & txcount < 14)));
+	assign	fill_take =	fill_open & ~txfifo_empty & tx_credit_avail & (fill_count != fill_max);
+	assign	frame_bytes =	{5'b00000, fill_count, 3'b000};
+	assign	buf_we =	fill_take | (state == STATE_Gather & gather_take & ~gather_match & gather_slots < TxFrameWords);
+	assign	buf_waddr =	fill_take ? fill_count : {4'h0, gather_slots};
 
 	//--------------------------------------------------------------------------
 	//	Packet header ROM
@@ -162,10 +317,10 @@ module EthernetFIFOTx(
 			4'b1001: rom_data = MACAddress[23:16];
 			4'b1010: rom_data = MACAddress[15:8];
 			4'b1011: rom_data = MACAddress[7:0];
-			4'b1100: rom_data = 8'h88;
-			4'b1101: rom_data = 8'h88;
-			4'b1110: rom_data = 8'h00;
-			4'b1111: rom_data = 8'h08;
+			4'b1100: rom_data = tx_udp ? 8'h08 : 8'h88;
+			4'b1101: rom_data = tx_udp ? 8'h00 : 8'h88;
+			4'b1110: rom_data = (cframe ? 8'h00 : frame_bytes[15:8]) | {1'b0, credit_word, 6'b000000};
+			4'b1111: rom_data = cframe ? 8'h09 : frame_bytes[7:0];
 			default: rom_data = 8'hxx;
 		    endcase
 		end
@@ -176,24 +331,100 @@ module EthernetFIFOTx(
 
 	always @(*)
 		case (tx_sel)
-			3'b000: tx_data = mac_data;
-			3'b001: tx_data = rom_data;
-			3'b010: tx_data = fifo_data;
-			3'b011: tx_data = 8'hFF;
-			3'b100: tx_data = 8'hFE;
-			default: tx_data = 8'hxx;		
+			4'b0000: tx_data = mac_data;
+			4'b0001: tx_data = rom_data;
+			4'b0010: tx_data = fifo_data;
+			4'b0011: tx_data = 8'hFF;
+			4'b0100: tx_data = 8'hFE;
+			4'b0101: tx_data = cheader_data;
+			4'b0110: tx_data = lit_data;
+			4'b0111: tx_data = LocalCaps;
+			4'b1000: tx_data = 8'hFC;
+			4'b1001: tx_data = tx_bulk_ack[7:0];
+			4'b1010: tx_data = {7'b0000000, tx_bulk_ack[8]};
+			4'b1011: tx_data = window_data;
+			4'b1100: tx_data = credit_data;
+			4'b1101: tx_data = ip_data;
+			default: tx_data = 8'hxx;
 		endcase
 
 	always @(*)
 		case (txcount[2:0])
-			3'b000: fifo_data = txfifo_data[63:56];
-			3'b001: fifo_data = txfifo_data[55:48];
-			3'b010: fifo_data = txfifo_data[47:40];
-			3'b011: fifo_data = txfifo_data[39:32];
-			3'b100: fifo_data = txfifo_data[31:24];
-			3'b101: fifo_data = txfifo_data[23:16];
-			3'b110: fifo_data = txfifo_data[15:8];
-			3'b111: fifo_data = txfifo_data[7:0];
+			3'b001: window_data = RxWindow[31:24];
+			3'b010: window_data = RxWindow[23:16];
+			3'b011: window_data = RxWindow[15:8];
+			3'b100: window_data = RxWindow[7:0];
+			default: window_data = 8'hxx;
+		endcase
+
+	always @(*)
+		case (ip_count)
+			5'd0:  ip_data = 8'h45;
+			5'd1:  ip_data = 8'h00;
+			5'd2:  ip_data = ip_len[15:8];
+			5'd3:  ip_data = ip_len[7:0];
+			5'd4:  ip_data = 8'h00;
+			5'd5:  ip_data = 8'h00;
+			5'd6:  ip_data = 8'h40;		// don't fragment
+			5'd7:  ip_data = 8'h00;
+			5'd8:  ip_data = IPTimeToLive;
+			5'd9:  ip_data = 8'h11;		// UDP
+			5'd10: ip_data = ip_csum[15:8];
+			5'd11: ip_data = ip_csum[7:0];
+			5'd12: ip_data = IPAddress[31:24];
+			5'd13: ip_data = IPAddress[23:16];
+			5'd14: ip_data = IPAddress[15:8];
+			5'd15: ip_data = IPAddress[7:0];
+			5'd16: ip_data = tx_dest_ip[31:24];
+			5'd17: ip_data = tx_dest_ip[23:16];
+			5'd18: ip_data = tx_dest_ip[15:8];
+			5'd19: ip_data = tx_dest_ip[7:0];
+			5'd20: ip_data = UDPPort[15:8];
+			5'd21: ip_data = UDPPort[7:0];
+			5'd22: ip_data = tx_dest_port[15:8];
+			5'd23: ip_data = tx_dest_port[7:0];
+			5'd24: ip_data = udp_len[15:8];
+			5'd25: ip_data = udp_len[7:0];
+			default: ip_data = 8'h00;
+		endcase
+
+	always @(*)
+		case (txcount[2:0])
+			3'b000: credit_data = credit_field[15:8];
+			3'b001: credit_data = credit_field[7:0];
+			default: credit_data = 8'h00;
+		endcase
+
+	always @(*)
+		case (txcount[1:0])
+			2'b00: cheader_data = {4'h0, gather_slots};
+			2'b01: cheader_data = gather_bitmap;
+			2'b10: cheader_data = gather_repeat;
+			2'b11: cheader_data = 8'h00;
+		endcase
+
+	always @(*)
+		case (txcount[2:0])
+			3'b000: lit_data = tx_lit[lit_idx][63:56];
+			3'b001: lit_data = tx_lit[lit_idx][55:48];
+			3'b010: lit_data = tx_lit[lit_idx][47:40];
+			3'b011: lit_data = tx_lit[lit_idx][39:32];
+			3'b100: lit_data = tx_lit[lit_idx][31:24];
+			3'b101: lit_data = tx_lit[lit_idx][23:16];
+			3'b110: lit_data = tx_lit[lit_idx][15:8];
+			3'b111: lit_data = tx_lit[lit_idx][7:0];
+		endcase
+
+	always @(*)
+		case (txcount[2:0])
+			3'b000: fifo_data = tx_buf[buf_idx][63:56];
+			3'b001: fifo_data = tx_buf[buf_idx][55:48];
+			3'b010: fifo_data = tx_buf[buf_idx][47:40];
+			3'b011: fifo_data = tx_buf[buf_idx][39:32];
+			3'b100: fifo_data = tx_buf[buf_idx][31:24];
+			3'b101: fifo_data = tx_buf[buf_idx][23:16];
+			3'b110: fifo_data = tx_buf[buf_idx][15:8];
+			3'b111: fifo_data = tx_buf[buf_idx][7:0];
 		endcase
 
 	always @(*)
@@ -214,9 +445,13 @@ module EthernetFIFOTx(
 	always @ (*) begin
 		txen_reg = 		1'b1;
 		txfifo_re_reg = 	1'b0;
-		rx_token_decr_reg = 	1'b0;
-		tx_sel = 		3'b000;
+		credit_take =		1'b0;
+		bulk_ack_re_reg =	1'b0;
+		tx_sel = 		4'b0000;
 		txcount_rst = 		1'b0;
+		txcount_hold =		1'b0;
+		ip_load =		1'b0;
+		ip_choice =		STATE_Header;
 		clear_ack = 		1'b0;
 		nstate = 		state;
 		
@@ -224,7 +459,25 @@ module EthernetFIFOTx(
 			STATE_Idle: begin
 				txen_reg = 1'b0;
 				txcount_rst = 1'b1;
-				if (tx_send_token | (~txfifo_empty & tx_credit_avail) | send_ack) 
+				if (tx_compress & ~txfifo_empty & tx_credit_avail & ~token_pending & ~send_ack & ~tx_send_bulk_ack)
+					nstate = STATE_Gather;
+				else if (token_pending | send_ack | tx_send_bulk_ack) 
+					nstate = STATE_Start;
+				else if (~txfifo_empty & tx_credit_avail)
+					nstate = STATE_Fill;
+			end
+			STATE_Fill: begin
+				txen_reg = 1'b0;
+				txcount_rst = 1'b1;
+				if (fill_count + fill_take == fill_max | fill_timer >= TxFillTimeout)
+					nstate = STATE_Start;
+			end
+			STATE_Gather: begin
+				txen_reg = 1'b0;
+				txcount_rst = 1'b1;
+				if (gather_take)
+					txfifo_re_reg = 1'b1;
+				else
 					nstate = STATE_Start;
 			end
 			STATE_Start: begin
@@ -236,39 +489,102 @@ module EthernetFIFOTx(
 			end
 			STATE_Header: begin
 				if (txcount > 5)
-					tx_sel = 3'b001;
-				if (txcount == 13) begin
+					tx_sel = 4'b0001;
+				if (txcount == 13 & ~cframe & ~dframe) begin
 					if (send_ack)
 						nstate = STATE_Ack;
-					else if (tx_send_token)
+					else if (tx_send_bulk_ack)
+						nstate = STATE_BulkAck;
+					else if (token_bank != 16'h0000) begin
+						credit_take = 1'b1;
 						nstate = STATE_Token;
+					end
+				end
+				// the credit word flag goes out in the type at txcount 14
+				if (txcount == 13 & (cframe | dframe) & piggyback & token_bank != 16'h0000)
+					credit_take = 1'b1;
+				// over UDP the IP header comes first, then the state chosen
+				// above; txcount holds from here so the header resumes at 14
+				if (txcount == 13 & tx_udp) begin
+					txcount_hold = 1'b1;
+					ip_load = 1'b1;
+					ip_choice = nstate;
+					nstate = STATE_IPHeader;
 				end
 				if (txcount == 15)
-					nstate = STATE_Data;
+					nstate = credit_word ? STATE_Credit : cframe ? STATE_CHeader : STATE_Data;
+			end
+			STATE_IPHeader: begin
+				tx_sel = 4'b1101;
+				if (ip_count == IPHeaderLen - 1)
+					nstate = ip_next;
+				else
+					txcount_hold = 1'b1;
+			end
+			STATE_Credit: begin
+				tx_sel = 4'b1100;
+				if (txcount[2:0] == 3'b111)
+					nstate = cframe ? STATE_CHeader : dframe ? STATE_Data : STATE_Idle;
+			end
+			STATE_CHeader: begin
+				tx_sel = 4'b0101;
+				if (txcount[1:0] == 2'b11) begin
+					txcount_rst = 1'b1;
+					if (gather_nlit == 4'h0)
+						nstate = STATE_Idle;
+					else
+						nstate = STATE_CData;
+				end
+			end
+			STATE_CData: begin
+				tx_sel = 4'b0110;
+				if (txcount[2:0] == 3'b111 & lit_idx + 1 == gather_nlit)
+					nstate = STATE_Idle;
 			end
 			STATE_Data: begin
-				tx_sel = 3'b010;
-				if (txcount == 7) begin
+				tx_sel = 4'b0010;
+				if (txcount[2:0] == 3'b111 & buf_idx + 1 == fill_count)
 					nstate = STATE_Idle;
-					txfifo_re_reg = 1'b1;
-				end
 			end
 			STATE_Token: begin
-				tx_sel = 3'b011;
-				if (txcount == 15) begin
-					nstate = STATE_Idle;
-					rx_token_decr_reg = 1'b1;
-				end
+				tx_sel = 4'b0011;
+				if (txcount == 15)
+					nstate = credit_word ? STATE_Credit : STATE_Idle;
 			end
 			STATE_Ack: begin		
 				if (txcount == 14)
-					tx_sel = 3'b011;		
+					tx_sel = 4'b0011;		
 				if (txcount == 15) begin
-					tx_sel = 3'b100;
+					tx_sel = 4'b0100;
 					clear_ack = 1'b1;
+					nstate = STATE_Caps;
+				end
+			end
+			STATE_BulkAck: begin
+				if (txcount == 14)
+					tx_sel = 4'b0011;
+				if (txcount == 15) begin
+					tx_sel = 4'b1000;
+					nstate = STATE_BulkAckData;
+				end
+			end
+			STATE_BulkAckData: begin
+				tx_sel = 4'b1001;
+				if (txcount == 1) begin
+					tx_sel = 4'b1010;
+					bulk_ack_re_reg = 1'b1;
 					nstate = STATE_Idle;
 				end
 			end
+			STATE_Caps: begin
+				// capabilities byte followed by the 32 bit receive window
+				if (txcount == 0)
+					tx_sel = 4'b0111;
+				else
+					tx_sel = 4'b1011;
+				if (txcount == 4)
+					nstate = STATE_Idle;
+			end
 		endcase
 	end
 
@@ -284,8 +600,16 @@ module EthernetFIFOTx(
 
 		if (txcount_rst) 
 			txcount <= 4'b0000;
-		else 
+		else if (~txcount_hold)
 			txcount <= txcount + 1;
+
+		if (state != STATE_IPHeader)
+			ip_count <= 5'h00;
+		else
+			ip_count <= ip_count + 1;
+
+		if (ip_load)
+			ip_next <= ip_choice;
 		
 		if (reset) 
 			send_ack_reg <= 2'b00;
@@ -296,6 +620,72 @@ module EthernetFIFOTx(
 			send_ack <= 1'b0;
 		else if (send_ack_reg[1]) 
 			send_ack <= 1'b1;
+
+		if (state == STATE_Idle) begin
+			gather_slots <= 4'h0;
+			gather_repeat <= 8'h00;
+			gather_bitmap <= 8'h00;
+			gather_nlit <= 4'h0;
+			gather_rpt <= 1'b0;
+			lit_idx <= 4'h0;
+		end
+		else if (state == STATE_Gather & gather_take) begin
+			if (gather_match) begin
+				gather_repeat <= gather_repeat + 1;
+				gather_rpt <= 1'b1;
+			end
+			else begin
+				gather_slots <= gather_slots + 1;
+				gather_last <= txfifo_data;
+				if (|txfifo_data) begin
+					gather_bitmap[3'd7 - gather_slots[2:0]] <= 1'b1;
+					tx_lit[gather_nlit] <= txfifo_data;
+					gather_nlit <= gather_nlit + 1;
+				end
+			end
+		end
+		else if (gather_plain) begin
+			gather_slots <= 4'h0;
+			gather_bitmap <= 8'h00;
+			gather_nlit <= 4'h0;
+		end
+		else if (state == STATE_CData & txcount[2:0] == 3'b111)
+			lit_idx <= lit_idx + 1;
+
+		if (state == STATE_Idle) begin
+			fill_count <= 8'h00;
+			fill_timer <= 16'h0000;
+			buf_idx <= 8'h00;
+			dframe <= 1'b0;
+		end
+		else begin
+			if (buf_we)
+				tx_buf[buf_waddr] <= txfifo_data;
+			if (fill_take)
+				fill_count <= fill_count + 1;
+			if (gather_plain) begin
+				fill_count <= {4'h0, gather_slots};
+				dframe <= 1'b1;
+			end
+			if (state == STATE_Fill) begin
+				fill_timer <= fill_timer + 1;
+				dframe <= 1'b1;
+			end
+			if (state == STATE_Data & txcount[2:0] == 3'b111)
+				buf_idx <= buf_idx + 1;
+		end
+
+		if (reset)
+			token_bank <= 16'h0000;
+		else
+			token_bank <= token_bank + rx_token_decr - (credit_take ? credit_amount : 16'h0000);
+
+		if (state == STATE_Idle)
+			credit_word <= 1'b0;
+		else if (credit_take) begin
+			credit_word <= piggyback;
+			credit_field <= credit_amount;
+		end
    end
 	
 endmodule
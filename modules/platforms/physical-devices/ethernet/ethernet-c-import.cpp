@@ -4,6 +4,7 @@
 extern "C"
 {
 #include "ramp_fifo.h"
+#include "ramp_trace.h"
 }
 
 #include "asim/provides/ethernet_device.h"
@@ -21,11 +22,37 @@ ETHERNET_DEVICE_CLASS::ETHERNET_DEVICE_CLASS(
     HASIM_MODULE p) :
         HASIM_MODULE_CLASS(p)
 {
-    // TODO: take ethernet device from command-line parameter.
-    if (ramp_chan_init(&pchannel, "eth0") != 0) {
+    // talk to the board over UDP if it has been given an address,
+    // otherwise in raw frames on the local link
+    int ret;
+    if (ETHERNET_UDP_HOST[0] != '\0')
+    {
+        ret = ramp_chan_init_udp(&pchannel, ETHERNET_UDP_HOST, ETHERNET_UDP_PORT);
+    }
+    else
+    {
+        // TODO: take ethernet device from command-line parameter.
+        ret = ramp_chan_init(&pchannel, "eth0");
+    }
+
+    if (ret != 0) {
             cerr << "ethernet device: unable to open driver" << endl;
             exit(1);
     }
+
+    // optionally record all traffic for offline replay; the channel
+    // stamps each word as it crosses the link
+    tracing = false;
+    if (ETHERNET_TRACE_FILE[0] != '\0')
+    {
+        if (ramp_trace_create(&trace, ETHERNET_TRACE_FILE) != 0)
+        {
+            cerr << "ethernet device: unable to create trace " << ETHERNET_TRACE_FILE << endl;
+            exit(1);
+        }
+        ramp_chan_trace(&pchannel, &trace);
+        tracing = true;
+    }
 }
 
 ETHERNET_DEVICE_CLASS::~ETHERNET_DEVICE_CLASS()
@@ -49,37 +76,83 @@ void
 ETHERNET_DEVICE_CLASS::Cleanup()
 {
     ramp_chan_close(&pchannel);
+
+    if (tracing)
+    {
+        if (trace.failed)
+        {
+            cerr << "ethernet device: ERROR: unable to write trace " << ETHERNET_TRACE_FILE
+                 << ", recording stopped after " << trace.nrecs << " words" << endl;
+        }
+        ramp_trace_close(&trace);
+        tracing = false;
+    }
 }
 
 int
 ETHERNET_DEVICE_CLASS::deq(UINT64 *data)
 {
-    int ret = ramp_fifo_deq(data, &pchannel);
+    // reading through the channel returns a credit token to the FPGA
+    int ret = ramp_chan_read8B(&pchannel, data);
     if (ret < 0)
     {
         cerr << "ethernet device: ERROR: deq() failed" << endl;
         Uninit();
         exit(1);
     }
-    return ret;
+
+    return ret / 8;
 }
 
 int
 ETHERNET_DEVICE_CLASS::enq(
     UINT64 data)
 {
-    int ret = ramp_fifo_enq(&pchannel, data);
-    if (ret > 0)
+    int ret = ramp_chan_write8B(&pchannel, &data);
+    if (ret != 8)
     {
         cerr << "ethernet device: ERROR: enq() failed" << endl;
         Uninit();
         exit(1);
     }
-    return ret;
+
+    return 0;
+}
+
+// enqueue a group of words at once so that the driver can
+// pack them into compressed packets
+int
+ETHERNET_DEVICE_CLASS::enq(
+    const UINT64 *data,
+    int n)
+{
+    int ret = ramp_chan_write(&pchannel, reinterpret_cast<const uint64_t *>(data), n);
+    if (ret != n)
+    {
+        cerr << "ethernet device: ERROR: enq() failed" << endl;
+        Uninit();
+        exit(1);
+    }
+
+    return 0;
 }
 
 int
 ETHERNET_DEVICE_CLASS::empty()
 {
-    return pchannel->rx_buffer.tail == pchannel->rx_buffer.head;
+    return pchannel.rx_buffer.tail == pchannel.rx_buffer.head;
+}
+
+// load a file straight into the board's DDR2, bypassing the FIFO
+int
+ETHERNET_DEVICE_CLASS::bulkLoad(
+    UINT64 addr,
+    const char *path)
+{
+    int ret = ramp_chan_bulk_load(&pchannel, addr, path);
+    if (ret != 0)
+    {
+        cerr << "ethernet device: bulk load of " << path << " failed" << endl;
+    }
+    return ret;
 }
@@ -6,6 +6,7 @@
 extern "C"
 {
 #include "ramp_fifo.h"
+#include "ramp_trace.h"
 }
 
 // ===============================================
@@ -20,6 +21,10 @@ class ETHERNET_DEVICE_CLASS: public HASIM_MODULE_CLASS
         // instantiate the C handle
 	ramp_chan_t pchannel;
 
+        // trace of all words passing through the device, if recording
+        ramp_trace_t trace;
+        bool         tracing;
+
     public:
         ETHERNET_DEVICE_CLASS(HASIM_MODULE);
         ~ETHERNET_DEVICE_CLASS();
@@ -27,9 +32,12 @@ class ETHERNET_DEVICE_CLASS: public HASIM_MODULE_CLASS
         void     Cleanup();
         void     Uninit();
         
-        int enq(UINT64 * val);
+        int enq(UINT64 val);
+        int enq(const UINT64 *vals, int n);
         int deq(UINT64 * val);
         int empty();
+
+        int bulkLoad(UINT64 addr, const char *path);
 };
 
 #endif
@@ -0,0 +1,135 @@
+#include <iostream>
+#include <unistd.h>
+
+extern "C"
+{
+#include "ramp_trace.h"
+}
+
+#include "asim/provides/ethernet_device.h"
+
+using namespace std;
+
+// ============================================
+//           Ethernet Replay Device
+// ============================================
+
+ETHERNET_DEVICE_CLASS::ETHERNET_DEVICE_CLASS(
+    HASIM_MODULE p) :
+        HASIM_MODULE_CLASS(p),
+        next(0),
+        paced(ETHERNET_REPLAY_PACED != 0),
+        started(false)
+{
+    if (ramp_trace_open(&trace, ETHERNET_REPLAY_FILE) != 0)
+    {
+        cerr << "ethernet replay device: unable to open trace " << ETHERNET_REPLAY_FILE << endl;
+        exit(1);
+    }
+    open = true;
+}
+
+ETHERNET_DEVICE_CLASS::~ETHERNET_DEVICE_CLASS()
+{
+    Cleanup();
+}
+
+// override default chain-uninit method because
+// we need to do something special
+void
+ETHERNET_DEVICE_CLASS::Uninit()
+{
+    Cleanup();
+
+    // call default uninit so that we can continue
+    // chain if necessary
+    HASIM_MODULE_CLASS::Uninit();
+}
+
+void
+ETHERNET_DEVICE_CLASS::Cleanup()
+{
+    if (open)
+    {
+        ramp_trace_close(&trace);
+        open = false;
+    }
+}
+
+const ramp_trace_rec_t *
+ETHERNET_DEVICE_CLASS::nextRecord()
+{
+    const ramp_trace_rec_t *rec;
+
+    while ((rec = ramp_trace_get(&trace, next)) != NULL &&
+           (rec->stamp & 1) != RAMP_TRACE_FROM_FPGA)
+    {
+        next++;
+    }
+
+    return rec;
+}
+
+// a word is available once its record is reached and, when pacing,
+// its recorded time relative to the first read has passed
+int
+ETHERNET_DEVICE_CLASS::empty()
+{
+    const ramp_trace_rec_t *rec = nextRecord();
+
+    if (rec == NULL)
+    {
+        return 1;
+    }
+
+    if (paced)
+    {
+        // replay times are relative to the first word read
+        if (!started)
+        {
+            offset = INT64(ramp_trace_now(&trace)) - INT64(rec->stamp >> 1);
+            started = true;
+        }
+
+        return INT64(ramp_trace_now(&trace)) < INT64(rec->stamp >> 1) + offset;
+    }
+
+    return 0;
+}
+
+int
+ETHERNET_DEVICE_CLASS::deq(UINT64 *data)
+{
+    if (empty())
+    {
+        return 0;
+    }
+
+    *data = ramp_trace_get(&trace, next)->data;
+    next++;
+    return 1;
+}
+
+// words to the FPGA are dropped
+int
+ETHERNET_DEVICE_CLASS::enq(
+    UINT64 data)
+{
+    return 0;
+}
+
+int
+ETHERNET_DEVICE_CLASS::enq(
+    const UINT64 *data,
+    int n)
+{
+    return 0;
+}
+
+int
+ETHERNET_DEVICE_CLASS::bulkLoad(
+    UINT64 addr,
+    const char *path)
+{
+    return 0;
+}
@@ -0,0 +1,54 @@
+#ifndef __ETHERNET_DEVICE__
+#define __ETHERNET_DEVICE__
+
+#include "hasim-module.h"
+
+extern "C"
+{
+#include "ramp_trace.h"
+}
+
+// ===============================================
+//            Ethernet Replay Device
+// ===============================================
+
+// Stands in for the Ethernet device, feeding the host the FPGA to host
+// words of a recorded trace and discarding everything written to it, so
+// that the host software can be benchmarked without a board.
+
+// =========== The actual Device Class ===========
+typedef class ETHERNET_DEVICE_CLASS* ETHERNET_DEVICE;
+class ETHERNET_DEVICE_CLASS: public HASIM_MODULE_CLASS
+{
+    private:
+        // the recorded trace
+        ramp_trace_t trace;
+        bool         open;
+
+        // next record to consider for deq
+        UINT64       next;
+
+        // replay at the recorded pacing
+        bool         paced;
+        bool         started;
+        INT64        offset;
+
+        // skip to the next FPGA to host record, return NULL at the end
+        const ramp_trace_rec_t *nextRecord();
+
+    public:
+        ETHERNET_DEVICE_CLASS(HASIM_MODULE);
+        ~ETHERNET_DEVICE_CLASS();
+
+        void     Cleanup();
+        void     Uninit();
+        
+        int enq(UINT64 val);
+        int enq(const UINT64 *vals, int n);
+        int deq(UINT64 * val);
+        int empty();
+
+        int bulkLoad(UINT64 addr, const char *path);
+};
+
+#endif
@@ -43,6 +43,50 @@
 #include <stdio.h>
 #include <errno.h>
 #include <unistd.h>
+#include <endian.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <netdb.h>
+#include <time.h>
+#include <sys/time.h>
+
+// UDP offload socket options, for C libraries that predate them
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+#include "ramp_marshal.h"
+
+static int ramp_chan_start(ramp_chan_t *chanp, int sock);
+static void ramp_msg_init(ramp_chan_t *chanp, struct msghdr *msg, struct iovec *iov, void *header, size_t len);
+static int ramp_send_packet(ramp_chan_t *chanp, const void *packet, size_t len);
+static ssize_t ramp_recv_frame(ramp_chan_t *chanp, uint8_t *buf, size_t size);
+static int ramp_frame_ours(ramp_chan_t *chanp, const uint8_t *buf, ssize_t len);
+static void ramp_rx_packet(ramp_chan_t *chanp, const uint8_t *buf, ssize_t len);
+static int ramp_send_data_gso(ramp_chan_t *chanp, const uint64_t *bufp, int nwords, int frame);
+static int ramp_cgroup_compress(ramp_cpacket_t *packet, const uint64_t *bufp, int nwords);
+static int ramp_cgroup_next(ramp_chan_t *chanp, ramp_cpacket_t *packet, const uint64_t *bufp, int nwords, int *ngroup);
+static int ramp_cgroup_expand(ramp_chan_t *chanp, const uint8_t *group, ssize_t len);
+static int ramp_bulk_wait(ramp_chan_t *chanp, uint32_t credit);
+static uint32_t ramp_reserve_tx_credit(ramp_chan_t *chanp, uint32_t want);
+static void ramp_return_tx_credit(ramp_chan_t *chanp, uint32_t n);
+static void ramp_receive_tx_credit(ramp_chan_t *chanp, uint32_t n);
+static int ramp_send_data(ramp_chan_t *chanp, const void *bufp, int nwords);
+static int ramp_send_frame(ramp_chan_t *chanp, uint16_t type, const void *body, size_t len);
+static void ramp_flush_rx_credit(ramp_chan_t *chanp);
+static void ramp_tx_unlock(ramp_chan_t *chanp);
+static int ramp_fifo_enq_payload(ramp_chan_t *chanp, const void *payload, int nwords);
+static void ramp_trace_words(ramp_chan_t *chanp, int dir, const uint64_t *words, int nwords);
+static void ramp_rx_idle(ramp_chan_t *chanp);
 					
 /**
  * ramp_chan_init - opens the network channel and initializes the channel
@@ -50,21 +94,18 @@
  * @chanp: ramp channel struct
  * @eth_device: name of the ethernet device to use
  *
+ * Packets are sent in raw ethernet frames, so the FPGA must be on the same
+ * link and the caller needs CAP_NET_RAW.
+ *
  * ramp_chan_init returns 0 if it successfully opens the channel,
  * returns -1 on failure;
  **/
 
 int ramp_chan_init(ramp_chan_t *chanp, const char *eth_device)
 {
-	int sock, ret, flags, optval;
-	ssize_t len;
+	int sock, ret;
 	struct ifreq ifr;
-	uint8_t buf[MAX_FRAME_SIZE];
 	uint8_t broadcast_addr[] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
-	ramp_packet_t *rx_packet;
-	socklen_t optlen;
-
-	rx_packet = (ramp_packet_t *) buf;	
 
 	sock = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
 	if (sock == -1) {
@@ -72,6 +113,118 @@ int ramp_chan_init(ramp_chan_t *chanp, const char *eth_device)
 		return -1;
 	}
 
+	// get MAC address of local ethernet device
+	strcpy(ifr.ifr_name, eth_device);
+	ret = ioctl(sock, SIOCGIFHWADDR, (char *)&ifr);
+	if (ret < 0) {
+		perror("ioctl");
+	        goto exit;
+	}
+
+	memset(&chanp->myaddr, '\0', sizeof(struct sockaddr_ll));
+	chanp->myaddr.sll_ifindex = if_nametoindex(eth_device);
+	chanp->myaddr.sll_family = AF_PACKET;
+   
+	ret = bind(sock, (struct sockaddr *)&chanp->myaddr, sizeof(struct sockaddr_ll));
+	if (ret == -1) {
+		perror("bind:");
+		goto exit;
+	}
+
+	// the ping packet is broadcast, and the FPGA's reply tells us its address
+	memcpy(&chanp->packet.dest_mac_addr, broadcast_addr, MAC_ADDR_LEN);
+	memcpy(&chanp->packet.src_mac_addr, &ifr.ifr_ifru.ifru_hwaddr.sa_data, MAC_ADDR_LEN);
+	chanp->udp = 0;
+
+	return ramp_chan_start(chanp, sock);
+
+exit:
+	close(sock);
+	return -1;
+}
+
+/**
+ * ramp_chan_init_udp - opens the network channel over UDP and initializes the
+ * channel structure
+ * @chanp: ramp channel struct
+ * @host: name or IPv4 address of the FPGA
+ * @port: UDP port of the FPGA
+ *
+ * Packets are encapsulated in UDP datagrams, so the FPGA may be behind a
+ * router and no privileges are needed.  Data packets are batched with UDP
+ * segmentation offload and received packets coalesced with UDP receive
+ * offload where the kernel supports them.
+ *
+ * The FPGA does not answer ARP, so whichever machine delivers its frames (this
+ * host, or the router in front of the FPGA) needs a static ARP entry for its
+ * ETHERNET_IP_ADDRESS and ETHERNET_MAC_ADDRESS, e.g.
+ * "arp -s 192.168.10.2 11:22:33:44:55:66" for the defaults.
+ *
+ * ramp_chan_init_udp returns 0 if it successfully opens the channel,
+ * returns -1 on failure;
+ **/
+
+int ramp_chan_init_udp(ramp_chan_t *chanp, const char *host, uint16_t port)
+{
+	int sock, ret;
+	struct addrinfo hints, *ai;
+	char service[8];
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_DGRAM;
+	snprintf(service, sizeof(service), "%u", port);
+
+	ret = getaddrinfo(host, service, &hints, &ai);
+	if (ret != 0) {
+		fprintf(stderr, "getaddrinfo: %s: %s\n", host, gai_strerror(ret));
+		return -1;
+	}
+
+	sock = socket(AF_INET, SOCK_DGRAM, 0);
+	if (sock == -1) {
+		perror("socket:");
+		freeaddrinfo(ai);
+		return -1;
+	}
+
+	// only the FPGA's datagrams are received, and sends need no address
+	ret = connect(sock, ai->ai_addr, ai->ai_addrlen);
+	freeaddrinfo(ai);
+	if (ret == -1) {
+		perror("connect");
+		close(sock);
+		return -1;
+	}
+
+	memset(&chanp->packet, 0, offsetof(ramp_packet_t, ether_type));
+	chanp->udp = 1;
+
+	return ramp_chan_start(chanp, sock);
+}
+
+/**
+ * ramp_chan_start - pings the FPGA over an open socket and starts the channel
+ * @chanp: ramp channel struct, with its header template addresses filled in
+ * @sock: socket to use, closed on failure
+ *
+ * ramp_chan_start returns 0 if the FPGA answered, returns -1 on failure;
+ **/
+
+static int ramp_chan_start(ramp_chan_t *chanp, int sock)
+{
+	int ret, flags, optval;
+	ssize_t len;
+	uint8_t buf[MAX_FRAME_SIZE];
+	ramp_packet_t *rx_packet;
+	socklen_t optlen;
+	uint32_t window;
+	struct timeval timeout;
+
+	rx_packet = (ramp_packet_t *) buf;	
+	chanp->socket = sock;
+	chanp->gso_buf = NULL;
+
 	optlen = sizeof(const void *);
 	optval = RCV_SOCKBUFLEN;
 
@@ -93,24 +246,6 @@ int ramp_chan_init(ramp_chan_t *chanp, const char *eth_device)
 		goto exit;
 	}
 
-	// get MAC address of local ethernet device
-	strcpy(ifr.ifr_name, eth_device);
-	ret = ioctl(sock, SIOCGIFHWADDR, (char *)&ifr);
-	if (ret < 0) {
-		perror("ioctl");
-	        goto exit;
-	}
-
-	memset(&chanp->myaddr, '\0', sizeof(struct sockaddr_ll));
-	chanp->myaddr.sll_ifindex = if_nametoindex(eth_device);
-	chanp->myaddr.sll_family = AF_PACKET;
-   
-	ret = bind(sock, (struct sockaddr *)&chanp->myaddr, sizeof(struct sockaddr_ll));
-	if (ret == -1) {
-		perror("bind:");
-		goto exit;
-	}
-
 	// make socket non-blocking
 	flags = fcntl(sock, F_GETFL,0);
 	if (flags == -1) flags = 0;
@@ -122,35 +257,42 @@ int ramp_chan_init(ramp_chan_t *chanp, const char *eth_device)
 	}
 
 	// construct a ping packet to test for the presence of a RAMP board
-	memcpy(&chanp->packet.dest_mac_addr, broadcast_addr, MAC_ADDR_LEN);
-	memcpy(&chanp->packet.src_mac_addr, &ifr.ifr_ifru.ifru_hwaddr.sa_data, MAC_ADDR_LEN);
 	chanp->packet.ether_type = htons(RAMP_ETHERTYPE);
 	chanp->packet.packet_type = htons(RAMP_PINGTYPE);
+	chanp->packet.data = 0;
+	*(uint8_t *) &chanp->packet.data = RAMP_LOCAL_CAPS;
+	chanp->caps = 0;
+	chanp->tx_window = INITIAL_TX_CREDIT;
 
 	// send a ping packet and listen for a response
 	// if we get a response, record the source MAC address of the packet
-	len = sendto(sock, &chanp->packet, PING_PACKET_LEN, 0, (struct sockaddr *) &chanp->myaddr, sizeof(struct sockaddr_ll));
-	if (len == -1) {
-		perror("sendto");
+	if (ramp_send_packet(chanp, &chanp->packet, PING_PACKET_LEN) != 0)
 		goto exit;
-	}
 
 	usleep(200000);
 	len = 0;
+	ret = 0;
 	
 	while (len != -1) {
-		len = read(sock, buf, MAX_FRAME_SIZE);
-		if (len == RAMP_PACKET_LEN) {
-			if (rx_packet->ether_type == ntohs(RAMP_ETHERTYPE) &&
-			    rx_packet->packet_type == ntohs(RAMP_PINGTYPE)) {
+		len = ramp_recv_frame(chanp, buf, MAX_FRAME_SIZE);
+		if (len >= PING_REPLY_LEN && ramp_frame_ours(chanp, buf, len) &&
+		    rx_packet->packet_type == ntohs(RAMP_PINGTYPE)) {
+			if (!chanp->udp)
 				memcpy(&chanp->packet.dest_mac_addr, &rx_packet->src_mac_addr, MAC_ADDR_LEN);
-				ret = 1;
-			}
+			// older boards leave the ping payload zeroed, i.e. no capabilities
+			// and the default window; the window follows the capabilities byte
+			chanp->caps = RAMP_LOCAL_CAPS & buf[16];
+			window = ((uint32_t) buf[17] << 24) | (buf[18] << 16) | (buf[19] << 8) | buf[20];
+			if (window != 0)
+				chanp->tx_window = window;
+			ret = 1;
 		}
 	}
 		
 	if (ret == 0) {
 		fprintf(stderr, "Couldn't detect a remote host on the link.\n");
+		if (chanp->udp)
+			fprintf(stderr, "The FPGA does not answer ARP; check there is a static ARP entry for it.\n");
 		goto exit;
 	}	
 
@@ -161,12 +303,40 @@ int ramp_chan_init(ramp_chan_t *chanp, const char *eth_device)
 		goto exit;
 	}
 
+	// but wake the receive thread when the link goes idle, so that it can
+	// return credit a reader is holding back
+	timeout.tv_sec = 0;
+	timeout.tv_usec = RAMP_CREDIT_FLUSH_MS * 1000;
+	ret = setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	if (ret == -1) {
+		perror("setsockopt");
+		goto exit;
+	}
+
+	// the offloads are optional, so older kernels just go without them
+	if (chanp->udp) {
+		optval = 1;
+		setsockopt(sock, SOL_UDP, UDP_GRO, &optval, sizeof(optval));
+
+		optlen = sizeof(optval);
+		if (getsockopt(sock, SOL_UDP, UDP_SEGMENT, &optval, &optlen) == 0)
+			chanp->gso_buf = malloc(RAMP_GRO_BUFLEN);
+	}
+
 	pthread_mutex_init(&chanp->tx_credit_mutex, NULL);
+	pthread_mutex_init(&chanp->tx_mutex, NULL);
+	pthread_mutex_init(&chanp->bulk_mutex, NULL);
 	pthread_cond_init(&chanp->tx_credit_cond, NULL);
+	pthread_cond_init(&chanp->bulk_credit_cond, NULL);
 	chanp->rx_buffer.head = 0;
 	chanp->rx_buffer.tail = 0;
-	chanp->tx_credit = INITIAL_TX_CREDIT;
-	chanp->socket = sock;
+	chanp->tx_credit = chanp->tx_window;
+	chanp->rx_credit_owed = 0;
+	chanp->bulk_credit = RAMP_BULK_FRAMES;
+	chanp->bulk_seq = 0;
+	chanp->bulk_ack_seq = 0;
+	chanp->bulk_error = 0;
+	chanp->trace = NULL;
 	
 	// spawn thread to receive and process packets
 	ret = pthread_create(&chanp->rx_thread, NULL, ramp_rx_thread, (void *) chanp);
@@ -179,6 +349,7 @@ int ramp_chan_init(ramp_chan_t *chanp, const char *eth_device)
 	return 0;
 
 exit:
+	free(chanp->gso_buf);
 	close(sock);
 	return -1;
 }
@@ -200,16 +371,120 @@ int ramp_chan_close(ramp_chan_t *chanp)
 		pthread_cancel(chanp->rx_thread);
 		pthread_join(chanp->rx_thread, 0);
 		pthread_mutex_destroy(&chanp->tx_credit_mutex);
+		pthread_mutex_destroy(&chanp->tx_mutex);
+		pthread_mutex_destroy(&chanp->bulk_mutex);
 		pthread_cond_destroy(&chanp->tx_credit_cond);
+		pthread_cond_destroy(&chanp->bulk_credit_cond);
+		free(chanp->gso_buf);
+	}
+	return 0;
+}
+
+/**
+ * ramp_msg_init - sets up a message to send a packet
+ * @chanp: ramp channel struct pointer
+ * @msg: message to set up
+ * @iov: array to hold the message's iovecs; the first is set to the header
+ * @header: packet header, starting with the ethernet header
+ * @len: length of the header
+ *
+ * Over UDP the ethernet header is left out and no address is needed.
+ **/
+
+static void ramp_msg_init(ramp_chan_t *chanp, struct msghdr *msg, struct iovec *iov, void *header, size_t len)
+{
+	size_t skip = chanp->udp ? UDP_SKIP_LEN : 0;
+
+	memset(msg, 0, sizeof(*msg));
+	if (!chanp->udp) {
+		msg->msg_name = &chanp->myaddr;
+		msg->msg_namelen = sizeof(struct sockaddr_ll);
+	}
+	msg->msg_iov = iov;
+	msg->msg_iovlen = 1;
+
+	iov[0].iov_base = (uint8_t *) header + skip;
+	iov[0].iov_len = len - skip;
+}
+
+/**
+ * ramp_send_packet - sends a complete packet
+ * @chanp: ramp channel struct pointer
+ * @packet: the packet, starting with the ethernet header
+ * @len: length of the packet in bytes
+ *
+ * ramp_send_packet returns 0 on success, -1 on an error.
+ **/
+
+static int ramp_send_packet(ramp_chan_t *chanp, const void *packet, size_t len)
+{
+	struct iovec iov;
+	struct msghdr msg;
+
+	ramp_msg_init(chanp, &msg, &iov, (void *) packet, len);
+	if (sendmsg(chanp->socket, &msg, 0) == -1) {
+		perror("sendmsg");
+		return -1;
 	}
 	return 0;
 }
 
+/**
+ * ramp_recv_frame - receives a single packet
+ * @chanp: ramp channel struct pointer
+ * @buf: buffer for the packet
+ * @size: size of the buffer
+ *
+ * The packet is laid out as an ethernet frame.  For a UDP datagram only
+ * the part from the packet type on is filled in.
+ *
+ * ramp_recv_frame returns the length of the frame, or -1 on an error.
+ **/
+
+static ssize_t ramp_recv_frame(ramp_chan_t *chanp, uint8_t *buf, size_t size)
+{
+	ssize_t len;
+
+	if (!chanp->udp)
+		return read(chanp->socket, buf, size);
+
+	len = recv(chanp->socket, buf + UDP_SKIP_LEN, size - UDP_SKIP_LEN, 0);
+	return (len == -1) ? -1 : len + UDP_SKIP_LEN;
+}
+
+/**
+ * ramp_frame_ours - checks that a received frame is a packet from the FPGA
+ * @chanp: ramp channel struct pointer
+ * @buf: the frame
+ * @len: length of the frame
+ *
+ * A connected UDP socket only receives the FPGA's datagrams, so only their
+ * length is checked.
+ **/
+
+static int ramp_frame_ours(ramp_chan_t *chanp, const uint8_t *buf, ssize_t len)
+{
+	const ramp_packet_t *rx_packet = (const ramp_packet_t *) buf;
+
+	if (chanp->udp)
+		return len >= DATA_HEADER_LEN;
+
+	return len >= RAMP_PACKET_LEN && 
+	       (memcmp(&chanp->packet.src_mac_addr, &rx_packet->dest_mac_addr, MAC_ADDR_LEN) == 0) &&
+	       ntohs(rx_packet->ether_type) == RAMP_ETHERTYPE;
+}
+
 /**
  * ramp_chan_read8B - non blocking read of 8 bytes of data from the network channel
  * @chanp: ramp channel struct pointer
  * @bufp: pointer to buffer where data will be written
  *
+ * The credit for the word is owed to the FPGA until the receive queue has
+ * been drained.  It is then returned in the next data packet if a write is
+ * in progress, or in a token otherwise.  Credit held back by a reader that
+ * stops before draining the queue is returned by the receive thread once
+ * the link has been idle for RAMP_CREDIT_FLUSH_MS.
+ *
  * ramp_chan_read8B returns 8 if it successfully reads 8 bytes of data,
  * returns 0 if the receive queue is empty, returns -1 if the channel is invalid.
  * 
@@ -221,8 +496,19 @@ int ramp_chan_read8B(ramp_chan_t *chanp, void *bufp)
 		return -1;
 	
 	if (ramp_fifo_deq(bufp, chanp)) {
-		if (ramp_send_rx_token(chanp) != 0)
-			fprintf(stderr, "Couldn't send rx credit token!\n");
+		__atomic_fetch_add(&chanp->rx_credit_owed, 1, __ATOMIC_ACQ_REL);
+		if (chanp->rx_buffer.tail != chanp->rx_buffer.head &&
+		    chanp->rx_credit_owed < RX_BUFFER_SIZE / 2)
+			return 8;
+
+		if (pthread_mutex_trylock(&chanp->tx_mutex) == 0)
+			ramp_tx_unlock(chanp);
+		else {
+			// wake a writer waiting for credit, so that it returns ours
+			pthread_mutex_lock(&chanp->tx_credit_mutex);
+			pthread_cond_broadcast(&chanp->tx_credit_cond);
+			pthread_mutex_unlock(&chanp->tx_credit_mutex);
+		}
 		return 8;
 	} else
 		return 0;
@@ -240,48 +526,740 @@ int ramp_chan_read8B(ramp_chan_t *chanp, void *bufp)
 
 int ramp_chan_write8B(ramp_chan_t *chanp, const void *bufp)
 {
-	ssize_t len;
+	int ret;
 
 	if (chanp == NULL)
 		return -1;
 
-	if (chanp->tx_credit == 0) {
-		pthread_mutex_lock(&chanp->tx_credit_mutex);
-		while (chanp->tx_credit == 0)
-			pthread_cond_wait(&chanp->tx_credit_cond, &chanp->tx_credit_mutex);
-		pthread_mutex_unlock(&chanp->tx_credit_mutex);
+	pthread_mutex_lock(&chanp->tx_mutex);
+	ramp_reserve_tx_credit(chanp, 1);
+	ret = ramp_send_data(chanp, bufp, 1);
+	ramp_tx_unlock(chanp);
+
+	return ret;
+}
+
+/**
+ * ramp_send_data - sends a group of 8 byte words in a data packet
+ * @chanp: ramp channel struct pointer
+ * @bufp: pointer to buffer from which data will be read
+ * @nwords: number of words to send, at most RAMP_FRAME_MAX_WORDS (or 1 if
+ * the remote end does not accept multi-word data packets)
+ *
+ * The words are converted to network byte order in bulk on their way into
+ * the packet.  The caller must hold tx_mutex and have reserved a credit for
+ * each word.
+ *
+ * ramp_send_data returns the number of bytes written,
+ * returns -1 on an error.
+ **/
+
+static int ramp_send_data(ramp_chan_t *chanp, const void *bufp, int nwords)
+{
+	uint64_t payload[RAMP_FRAME_MAX_WORDS];
+
+	ramp_marshal_pack(payload, bufp, nwords);
+
+	ramp_trace_words(chanp, RAMP_TRACE_TO_FPGA, bufp, nwords);
+	if (ramp_send_frame(chanp, RAMP_DATATYPE * nwords, payload, 8 * nwords) != 0)
+		return -1;
+
+	return 8 * nwords;
+}
+
+/**
+ * ramp_send_data_gso - sends a group of 8 byte words in several data packets at once
+ * @chanp: ramp channel struct pointer
+ * @bufp: pointer to buffer from which data will be read
+ * @nwords: number of words to send
+ * @frame: number of words per data packet
+ *
+ * Over UDP with segmentation offload, as many packets as fit are built back
+ * to back in gso_buf and handed to the kernel in one send.  Every packet but
+ * the last must be the same size, so they all get a credit word if the peer
+ * takes them, and only the first returns the credit we owe.  Otherwise a
+ * single packet is sent with ramp_send_data.  The caller must hold tx_mutex
+ * and have reserved a credit for each word.
+ *
+ * ramp_send_data_gso returns the number of bytes of data written,
+ * returns -1 on an error.
+ **/
+
+static int ramp_send_data_gso(ramp_chan_t *chanp, const uint64_t *bufp, int nwords, int frame)
+{
+	int hlen = DATA_HEADER_LEN - UDP_SKIP_LEN;
+	int seg;
+	uint8_t *p = chanp->gso_buf;
+	uint32_t owed = 0;
+	uint16_t type, gso_size;
+	int i, n, nsegs;
+	char control[CMSG_SPACE(sizeof(uint16_t))];
+	struct cmsghdr *cmsg;
+	struct iovec iov;
+	struct msghdr msg;
+
+	if (chanp->caps & RAMP_CAP_CREDITS)
+		hlen += CREDIT_WORD_LEN;
+	seg = hlen + 8 * frame;
+
+	nsegs = (nwords + frame - 1) / frame;
+	if (nsegs > RAMP_GSO_MAX_SEGMENTS)
+		nsegs = RAMP_GSO_MAX_SEGMENTS;
+	if (nsegs > RAMP_GRO_BUFLEN / seg)
+		nsegs = RAMP_GRO_BUFLEN / seg;
+
+	if (chanp->gso_buf == NULL || nsegs < 2)
+		return ramp_send_data(chanp, bufp, (nwords < frame) ? nwords : frame);
+
+	if (nwords > nsegs * frame)
+		nwords = nsegs * frame;
+
+	if (chanp->caps & RAMP_CAP_CREDITS)
+		owed = __atomic_exchange_n(&chanp->rx_credit_owed, 0, __ATOMIC_ACQ_REL);
+
+	for (i = 0; i < nwords; i += n) {
+		n = (nwords - i < frame) ? nwords - i : frame;
+		type = RAMP_DATATYPE * n;
+		if (chanp->caps & RAMP_CAP_CREDITS) {
+			type |= RAMP_CREDITFLAG;
+			memset(&p[2], 0, CREDIT_WORD_LEN);
+			if (i == 0) {
+				p[2] = owed >> 8;
+				p[3] = owed;
+			}
+		}
+		p[0] = type >> 8;
+		p[1] = type;
+		ramp_marshal_pack(&p[hlen], &bufp[i], n);
+		p += hlen + 8 * n;
+	}
+
+	iov.iov_base = chanp->gso_buf;
+	iov.iov_len = p - chanp->gso_buf;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	gso_size = seg;
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_UDP;
+	cmsg->cmsg_type = UDP_SEGMENT;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+	memcpy(CMSG_DATA(cmsg), &gso_size, sizeof(uint16_t));
+
+	ramp_trace_words(chanp, RAMP_TRACE_TO_FPGA, bufp, nwords);
+	if (sendmsg(chanp->socket, &msg, 0) == -1) {
+		perror("sendmsg");
+		__atomic_fetch_add(&chanp->rx_credit_owed, owed, __ATOMIC_ACQ_REL);
+		return -1;
+	}
+
+	return 8 * nwords;
+}
+
+/**
+ * ramp_send_frame - sends a data packet, returning any credit we owe in it
+ * @chanp: ramp channel struct pointer
+ * @type: packet type, flagged here if a credit word is added
+ * @body: the rest of the packet
+ * @len: length of the rest of the packet in bytes
+ *
+ * The caller must hold tx_mutex.
+ *
+ * ramp_send_frame returns 0 on success, -1 on an error.
+ **/
+
+static int ramp_send_frame(ramp_chan_t *chanp, uint16_t type, const void *body, size_t len)
+{
+	ramp_packet_t header;
+	uint8_t credit[CREDIT_WORD_LEN] = { 0 };
+	uint32_t owed = 0;
+	struct iovec iov[3];
+	struct msghdr msg;
+
+	memcpy(&header, &chanp->packet, offsetof(ramp_packet_t, packet_type));
+	ramp_msg_init(chanp, &msg, iov, &header, DATA_HEADER_LEN);
+
+	// the owed credit never exceeds our receive buffer, so it fits in the count
+	if (chanp->caps & RAMP_CAP_CREDITS) {
+		owed = __atomic_exchange_n(&chanp->rx_credit_owed, 0, __ATOMIC_ACQ_REL);
+		type |= RAMP_CREDITFLAG;
+		credit[0] = owed >> 8;
+		credit[1] = owed;
+		iov[1].iov_base = credit;
+		iov[1].iov_len = CREDIT_WORD_LEN;
+		msg.msg_iovlen = 2;
+	}
+	header.packet_type = htons(type);
+
+	iov[msg.msg_iovlen].iov_base = (void *) body;
+	iov[msg.msg_iovlen].iov_len = len;
+	msg.msg_iovlen++;
+
+	if (sendmsg(chanp->socket, &msg, 0) == -1) {
+		perror("sendmsg");
+		__atomic_fetch_add(&chanp->rx_credit_owed, owed, __ATOMIC_ACQ_REL);
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * ramp_flush_rx_credit - returns all the credit we owe in tokens
+ * @chanp: ramp channel struct pointer
+ *
+ * A peer that takes counted tokens gets a single token, otherwise one
+ * token is sent per credit.  The caller must hold tx_mutex.
+ **/
+
+static void ramp_flush_rx_credit(ramp_chan_t *chanp)
+{
+	uint32_t owed;
+
+	owed = __atomic_exchange_n(&chanp->rx_credit_owed, 0, __ATOMIC_ACQ_REL);
+	if (owed == 0)
+		return;
+
+	if (chanp->caps & RAMP_CAP_CREDITS) {
+		if (ramp_send_rx_token(chanp, owed) != 0)
+			fprintf(stderr, "Couldn't send rx credit token!\n");
+	} else {
+		while (owed-- > 0)
+			if (ramp_send_rx_token(chanp, 1) != 0)
+				fprintf(stderr, "Couldn't send rx credit token!\n");
+	}
+}
+
+/**
+ * ramp_tx_unlock - releases tx_mutex once no credit is owed
+ * @chanp: ramp channel struct pointer
+ *
+ * Credit owed when the transmit path goes idle is returned in tokens.  A
+ * reader that could not take tx_mutex leaves its credit to whoever holds
+ * it, so check again after releasing it.
+ **/
+
+static void ramp_tx_unlock(ramp_chan_t *chanp)
+{
+	do {
+		ramp_flush_rx_credit(chanp);
+		pthread_mutex_unlock(&chanp->tx_mutex);
+	} while (__atomic_load_n(&chanp->rx_credit_owed, __ATOMIC_ACQUIRE) != 0 &&
+		 pthread_mutex_trylock(&chanp->tx_mutex) == 0);
+}
+
+/**
+ * ramp_reserve_tx_credit - atomically takes transmit credit for a group of words
+ * @chanp: ramp channel struct pointer
+ * @want: number of credits wanted, must be at least 1
+ *
+ * Blocks until some credit is available, then takes as much of it as
+ * possible, up to want.  Any credit we owe is returned before blocking,
+ * since the FPGA may be waiting for it before it can free up ours.  The
+ * caller must hold tx_mutex.
+ *
+ * ramp_reserve_tx_credit returns the number of credits taken.
+ **/
+
+static uint32_t ramp_reserve_tx_credit(ramp_chan_t *chanp, uint32_t want)
+{
+	uint32_t n;
+
+	pthread_mutex_lock(&chanp->tx_credit_mutex);
+	while (chanp->tx_credit == 0) {
+		if (__atomic_load_n(&chanp->rx_credit_owed, __ATOMIC_ACQUIRE) != 0) {
+			pthread_mutex_unlock(&chanp->tx_credit_mutex);
+			ramp_flush_rx_credit(chanp);
+			pthread_mutex_lock(&chanp->tx_credit_mutex);
+			continue;
+		}
+		pthread_cond_wait(&chanp->tx_credit_cond, &chanp->tx_credit_mutex);
 	}
+	n = (chanp->tx_credit < want) ? chanp->tx_credit : want;
+	chanp->tx_credit -= n;
+	pthread_mutex_unlock(&chanp->tx_credit_mutex);
 
-	chanp->packet.packet_type = htons(RAMP_DATATYPE);
-	memcpy(&chanp->packet.data, bufp, 8);
+	return n;
+}
+
+/**
+ * ramp_return_tx_credit - gives back credit reserved but not used
+ * @chanp: ramp channel struct pointer
+ * @n: number of credits to return
+ **/
+
+static void ramp_return_tx_credit(ramp_chan_t *chanp, uint32_t n)
+{
+	if (n == 0)
+		return;
 
 	pthread_mutex_lock(&chanp->tx_credit_mutex);
-	chanp->tx_credit--;
+	chanp->tx_credit += n;
+	pthread_cond_broadcast(&chanp->tx_credit_cond);
 	pthread_mutex_unlock(&chanp->tx_credit_mutex);
-	
-	len = sendto(chanp->socket, &chanp->packet, DATA_PACKET_LEN, 0, (struct sockaddr *) &chanp->myaddr, sizeof(struct sockaddr_ll));
-	if (len == -1) {
-		perror("sendto");
+}
+
+/**
+ * ramp_receive_tx_credit - adds credit returned by the FPGA
+ * @chanp: ramp channel struct pointer
+ * @n: number of credits returned
+ *
+ * Credit beyond the FPGA's receive window is dropped with a warning.
+ **/
+
+static void ramp_receive_tx_credit(ramp_chan_t *chanp, uint32_t n)
+{
+	if (n == 0)
+		return;
+
+	pthread_mutex_lock(&chanp->tx_credit_mutex);
+	if (chanp->tx_credit + n > chanp->tx_window) {
+		fprintf(stderr, "TX credit token overflow!\n");
+		n = chanp->tx_window - chanp->tx_credit;
+	}
+	if (chanp->tx_credit == 0)
+		pthread_cond_broadcast(&chanp->tx_credit_cond);
+	chanp->tx_credit += n;
+	pthread_mutex_unlock(&chanp->tx_credit_mutex);
+}
+
+/**
+ * ramp_chan_write - blocking write of a group of 8 byte words to the network channel
+ * @chanp: ramp channel struct pointer
+ * @bufp: pointer to the words to be written
+ * @nwords: number of words to write
+ *
+ * If the remote end accepts compressed data packets, each group of words that
+ * compression shrinks is sent in a compressed data packet.  The rest are sent
+ * in multi-word data packets of up to RAMP_FRAME_MAX_WORDS if the remote end
+ * accepts them, or one per packet as with ramp_chan_write8B.  Over UDP, runs
+ * of multi-word packets go out in segmentation offload sends.  Concurrent
+ * writers are serialised so that the words of each call are contiguous on
+ * the wire.
+ *
+ * ramp_chan_write returns nwords if the data is successfully written,
+ * returns -1 on an error.
+ *
+ **/
+
+int ramp_chan_write(ramp_chan_t *chanp, const uint64_t *bufp, int nwords)
+{
+	ramp_cpacket_t packet;
+	uint32_t credit, frame, k;
+	ssize_t len;
+	int i, n, plain, ret = nwords;
+
+	if (chanp == NULL)
 		return -1;
+
+	pthread_mutex_lock(&chanp->tx_mutex);
+
+	frame = (chanp->caps & RAMP_CAP_FRAMES) ? RAMP_FRAME_MAX_WORDS : 1;
+	for (i = 0; i < nwords; i += credit) {
+		credit = ramp_reserve_tx_credit(chanp, nwords - i);
+		for (k = 0; k < credit; k += n) {
+			plain = ramp_cgroup_next(chanp, &packet, &bufp[i+k], credit - k, &n);
+			for (; plain > 0; plain -= len / 8, k += len / 8) {
+				len = ramp_send_data_gso(chanp, &bufp[i+k], plain, frame);
+				if (len == -1)
+					goto fail;
+			}
+			if (n > 0) {
+				ramp_trace_words(chanp, RAMP_TRACE_TO_FPGA, &bufp[i+k], n);
+				if (ramp_send_frame(chanp, RAMP_CDATATYPE, &packet.nslots,
+						    CDATA_HEADER_LEN - DATA_HEADER_LEN + 8 * __builtin_popcount(packet.bitmap)) != 0)
+					goto fail;
+			}
+		}
 	}
+	goto exit;
 
-	return 8;
+fail:
+	ramp_return_tx_credit(chanp, credit - k);
+	ret = -1;
+exit:
+	ramp_tx_unlock(chanp);
+	return ret;
 }
 
-int ramp_send_rx_token(ramp_chan_t *chanp)
+/**
+ * ramp_cgroup_next - finds the next group of words worth compressing
+ * @chanp: ramp channel struct pointer
+ * @packet: packet that the group is compressed into
+ * @bufp: words to be sent
+ * @nwords: number of words available, must be at least 1
+ * @ngroup: set to the number of words in the compressed group, 0 if none
+ *
+ * A group compresses to 8 bytes per literal plus a 4 byte group header, so
+ * it only saves space if it holds a zero word or a repeat.  Groups that do
+ * not are left to be sent as they are, unless the remote end only takes
+ * single word data packets, in which case any group saves packets.  The
+ * compressed group, if any, follows the words that are left.
+ *
+ * ramp_cgroup_next returns the number of words to send uncompressed ahead
+ * of the group.
+ **/
+
+static int ramp_cgroup_next(ramp_chan_t *chanp, ramp_cpacket_t *packet, const uint64_t *bufp, int nwords, int *ngroup)
 {
-	ssize_t len;
+	int plain = 0, n;
+
+	*ngroup = 0;
+	if (!(chanp->caps & RAMP_CAP_COMPRESS))
+		return nwords;
 
-	chanp->packet.packet_type = htons(RAMP_TOKENTYPE);
+	while (plain < nwords) {
+		n = ramp_cgroup_compress(packet, &bufp[plain], nwords - plain);
+		if (__builtin_popcount(packet->bitmap) < n || !(chanp->caps & RAMP_CAP_FRAMES)) {
+			*ngroup = n;
+			break;
+		}
+		plain += n;
+	}
+
+	return plain;
+}
+
+/**
+ * ramp_cgroup_compress - packs words into a compressed data packet
+ * @packet: packet whose group header and payload will be filled in
+ * @bufp: words to be packed
+ * @nwords: number of words available, must be at least 1
+ *
+ * Zero words take a slot but no payload.  Slots are filled until a word
+ * repeats its predecessor, after which the rest of that run is carried in
+ * the repeat count.
+ *
+ * ramp_cgroup_compress returns the number of words consumed from bufp.
+ **/
+
+static int ramp_cgroup_compress(ramp_cpacket_t *packet, const uint64_t *bufp, int nwords)
+{
+	int i = 0, nlit = 0;
+
+	if (nwords > RAMP_CGROUP_MAX_WORDS)
+		nwords = RAMP_CGROUP_MAX_WORDS;
+
+	packet->bitmap = 0;
+	packet->repeat = 0;
+	packet->reserved = 0;
+
+	do {
+		if (bufp[i] != 0) {
+			packet->bitmap |= 0x80 >> i;
+			packet->data[nlit++] = bufp[i];
+		}
+		i++;
+	} while (i < nwords && i < RAMP_CGROUP_SLOTS && bufp[i] != bufp[i-1]);
+
+	packet->nslots = i;
+	ramp_marshal_pack(packet->data, packet->data, nlit);
 
-	len = sendto(chanp->socket, &chanp->packet, TOKEN_PACKET_LEN, 0, (struct sockaddr *) &chanp->myaddr, sizeof(struct sockaddr_ll));
-	if (len == -1) {
-		perror("sendto");
+	while (i < nwords && bufp[i] == bufp[i-1]) {
+		packet->repeat++;
+		i++;
+	}
+
+	return i;
+}
+
+/**
+ * ramp_cgroup_expand - unpacks a received compressed data packet into the
+ * receive buffer
+ * @chanp: ramp channel struct pointer
+ * @group: group header of the received packet (laid out as from nslots in
+ * ramp_cpacket_t)
+ * @len: length of the received frame from the group header on
+ *
+ * ramp_cgroup_expand returns 0 on success, -1 if the packet is malformed or
+ * the receive buffer overflows.
+ **/
+
+static int ramp_cgroup_expand(ramp_chan_t *chanp, const uint8_t *group, ssize_t len)
+{
+	const ramp_cpacket_t *packet = (const ramp_cpacket_t *) (group - offsetof(ramp_cpacket_t, nslots));
+	uint64_t lit[RAMP_CGROUP_SLOTS];
+	uint64_t word = 0;
+	int i, nlit = 0;
+
+	if (len < CDATA_HEADER_LEN - DATA_HEADER_LEN || packet->nslots == 0 || packet->nslots > RAMP_CGROUP_SLOTS ||
+	    len < CDATA_HEADER_LEN - DATA_HEADER_LEN + 8 * __builtin_popcount(packet->bitmap))
 		return -1;
+
+	ramp_marshal_unpack(lit, packet->data, __builtin_popcount(packet->bitmap));
+
+	for (i = 0; i < packet->nslots; i++) {
+		word = (packet->bitmap & (0x80 >> i)) ? lit[nlit++] : 0;
+		if (ramp_fifo_enq(word, chanp) != 0)
+			return -1;
 	}
+
+	for (i = 0; i < packet->repeat; i++)
+		if (ramp_fifo_enq(word, chanp) != 0)
+			return -1;
+
 	return 0;
 }
 
+/**
+ * ramp_chan_bulk_write - blocking write of a block of memory to the FPGA's DDR2
+ * @chanp: ramp channel struct pointer
+ * @addr: DDR2 byte address to write to, must be 8 byte aligned
+ * @bufp: data to be written, typically a mapped file
+ * @len: length of the data in bytes (the last word is padded with zeros)
+ *
+ * The data is sent straight from bufp in bulk packets, which the FPGA writes
+ * to DDR2 without passing them through the FIFO.  Bulk packets do not
+ * consume FIFO credit, so FIFO traffic may continue in parallel.  Bulk
+ * writers are serialised, so each call's sequence numbers go out in order.
+ * With the FPGA's deep buffer enabled, packets reaching past
+ * ETHERNET_DEEP_BUFFER_BASE are refused, as DDR2 from there on holds the
+ * deep buffer's spill ring.
+ *
+ * ramp_chan_bulk_write returns 0 once every packet has been acknowledged,
+ * returns -1 if the channel does not support bulk writes, a send failed, or
+ * a packet was dropped or not acknowledged in time.
+ *
+ **/
+
+int ramp_chan_bulk_write(ramp_chan_t *chanp, uint64_t addr, const void *bufp, size_t len)
+{
+	static const uint8_t zeros[8] = { 0 };
+	ramp_bheader_t header;
+	struct iovec iov[3];
+	struct msghdr msg;
+	const uint8_t *p = bufp;
+	size_t n;
+	ssize_t ret = -1;
+
+	if (chanp == NULL || !(chanp->caps & RAMP_CAP_BULK) || (addr & 7))
+		return -1;
+
+	pthread_mutex_lock(&chanp->bulk_mutex);
+
+	// a failed write may have left packets unacknowledged: give their
+	// acknowledgements time to drain, then write off any that were lost
+	pthread_mutex_lock(&chanp->tx_credit_mutex);
+	if (chanp->bulk_error) {
+		chanp->bulk_error = 0;
+		ramp_bulk_wait(chanp, RAMP_BULK_FRAMES);
+		chanp->bulk_credit = RAMP_BULK_FRAMES;
+		chanp->bulk_ack_seq = chanp->bulk_seq;
+		chanp->bulk_error = 0;
+	}
+	pthread_mutex_unlock(&chanp->tx_credit_mutex);
+
+	memcpy(&header, &chanp->packet, offsetof(ramp_packet_t, packet_type));
+	header.packet_type = htons(RAMP_BULKTYPE);
+	memset(header.reserved, 0, sizeof(header.reserved));
+
+	ramp_msg_init(chanp, &msg, iov, &header, BULK_HEADER_LEN);
+	iov[2].iov_base = (void *) zeros;
+
+	while (len > 0) {
+		n = (len < RAMP_BULK_MAX_WORDS * 8) ? len : RAMP_BULK_MAX_WORDS * 8;
+
+		pthread_mutex_lock(&chanp->tx_credit_mutex);
+		if (ramp_bulk_wait(chanp, 1) != 0) {
+			pthread_mutex_unlock(&chanp->tx_credit_mutex);
+			goto exit;
+		}
+		chanp->bulk_credit--;
+		header.seq = chanp->bulk_seq++;
+		pthread_mutex_unlock(&chanp->tx_credit_mutex);
+
+		header.nwords = htons((n + 7) / 8);
+		header.addr = htobe64(addr);
+
+		// the payload goes straight from the caller's buffer, padded out to
+		// a whole word if necessary
+		iov[1].iov_base = (void *) p;
+		iov[1].iov_len = n;
+		iov[2].iov_len = (8 - (n & 7)) & 7;
+		msg.msg_iovlen = iov[2].iov_len ? 3 : 2;
+
+		if (sendmsg(chanp->socket, &msg, 0) == -1) {
+			perror("sendmsg");
+			// the packet never left, so neither its credit nor its
+			// sequence number was used
+			pthread_mutex_lock(&chanp->tx_credit_mutex);
+			chanp->bulk_credit++;
+			chanp->bulk_seq--;
+			pthread_mutex_unlock(&chanp->tx_credit_mutex);
+			goto exit;
+		}
+
+		p += n;
+		addr += n;
+		len -= n;
+	}
+
+	// wait until every outstanding bulk packet has been acknowledged
+	pthread_mutex_lock(&chanp->tx_credit_mutex);
+	ret = ramp_bulk_wait(chanp, RAMP_BULK_FRAMES);
+	pthread_mutex_unlock(&chanp->tx_credit_mutex);
+
+exit:
+	pthread_mutex_unlock(&chanp->bulk_mutex);
+	return ret;
+}
+
+/**
+ * ramp_bulk_wait - waits for bulk credit returned by acknowledgements
+ * @chanp: ramp channel struct pointer
+ * @credit: bulk credit to wait for
+ *
+ * If no acknowledgement arrives for RAMP_BULK_TIMEOUT_MS, a bulk packet or
+ * its acknowledgement was lost, and the channel is marked in error as for
+ * a dropped packet.  The caller must hold tx_credit_mutex.
+ *
+ * ramp_bulk_wait returns 0 once the credit is available, returns -1 if a
+ * packet was dropped or not acknowledged in time.
+ **/
+
+static int ramp_bulk_wait(ramp_chan_t *chanp, uint32_t credit)
+{
+	struct timespec deadline;
+	uint32_t seen;
+
+	while (chanp->bulk_credit < credit && !chanp->bulk_error) {
+		seen = chanp->bulk_credit;
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += RAMP_BULK_TIMEOUT_MS / 1000;
+		deadline.tv_nsec += (RAMP_BULK_TIMEOUT_MS % 1000) * 1000000L;
+		if (deadline.tv_nsec >= 1000000000L) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+
+		while (chanp->bulk_credit == seen && !chanp->bulk_error) {
+			if (pthread_cond_timedwait(&chanp->bulk_credit_cond, &chanp->tx_credit_mutex, &deadline) == ETIMEDOUT) {
+				fprintf(stderr, "Bulk packet %d was not acknowledged!\n", chanp->bulk_ack_seq);
+				chanp->bulk_error = 1;
+			}
+		}
+	}
+
+	return chanp->bulk_error ? -1 : 0;
+}
+
+/**
+ * ramp_chan_bulk_load - loads a file into the FPGA's DDR2
+ * @chanp: ramp channel struct pointer
+ * @addr: DDR2 byte address to load the file at, must be 8 byte aligned
+ * @path: file to load
+ *
+ * The file is mapped and streamed with ramp_chan_bulk_write.
+ *
+ * ramp_chan_bulk_load returns 0 on success, -1 on failure.
+ *
+ **/
+
+int ramp_chan_bulk_load(ramp_chan_t *chanp, uint64_t addr, const char *path)
+{
+	struct stat st;
+	void *p;
+	int fd, ret;
+
+	fd = open(path, O_RDONLY);
+	if (fd == -1) {
+		perror("open");
+		return -1;
+	}
+
+	if (fstat(fd, &st) == -1) {
+		perror("fstat");
+		close(fd);
+		return -1;
+	}
+
+	if (st.st_size == 0) {
+		close(fd);
+		return 0;
+	}
+
+	p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (p == MAP_FAILED) {
+		perror("mmap");
+		close(fd);
+		return -1;
+	}
+
+	madvise(p, st.st_size, MADV_SEQUENTIAL);
+
+	ret = ramp_chan_bulk_write(chanp, addr, p, st.st_size);
+
+	munmap(p, st.st_size);
+	close(fd);
+	return ret;
+}
+
+/**
+ * ramp_send_rx_token - returns receive credit to the FPGA in a token
+ * @chanp: ramp channel struct pointer
+ * @ncredits: number of credits, must be 1 unless the FPGA takes counted tokens
+ *
+ * ramp_send_rx_token returns 0 on success, -1 on an error.
+ **/
+
+int ramp_send_rx_token(ramp_chan_t *chanp, uint32_t ncredits)
+{
+	ramp_packet_t packet;
+
+	memcpy(&packet, &chanp->packet, offsetof(ramp_packet_t, packet_type));
+	packet.packet_type = htons(RAMP_TOKENTYPE);
+	packet.data = 0;
+	((uint8_t *) &packet.data)[0] = ncredits >> 8;
+	((uint8_t *) &packet.data)[1] = ncredits;
+
+	return ramp_send_packet(chanp, &packet, (chanp->caps & RAMP_CAP_CREDITS) ? TOKEN_PACKET_LEN + CREDIT_WORD_LEN : TOKEN_PACKET_LEN);
+}
+
+/**
+ * ramp_chan_trace - starts or stops recording the channel's traffic
+ * @chanp: ramp channel struct pointer
+ * @tracep: trace opened with ramp_trace_create, NULL to stop recording
+ *
+ * Words sent are recorded by the writer under tx_mutex, once it holds
+ * credit for them and just before they go on the wire, so no reply can be
+ * recorded ahead of them.  Words received are recorded by the receive
+ * thread as they are queued.  Each record is thus stamped when its word
+ * crossed the link, not when the application got to it.
+ **/
+
+void ramp_chan_trace(ramp_chan_t *chanp, ramp_trace_t *tracep)
+{
+	__atomic_store_n(&chanp->trace, tracep, __ATOMIC_RELEASE);
+}
+
+/**
+ * ramp_trace_words - records words in the channel's trace, if any
+ * @chanp: ramp channel struct pointer
+ * @dir: RAMP_TRACE_TO_FPGA or RAMP_TRACE_FROM_FPGA
+ * @words: the words, in host byte order
+ * @nwords: number of words
+ *
+ * A trace that fails stops recording, which its owner finds in its failed
+ * flag, so the channel carries on regardless.
+ **/
+
+static void ramp_trace_words(ramp_chan_t *chanp, int dir, const uint64_t *words, int nwords)
+{
+	ramp_trace_t *tracep = __atomic_load_n(&chanp->trace, __ATOMIC_ACQUIRE);
+	int i;
+
+	if (tracep == NULL)
+		return;
+
+	for (i = 0; i < nwords; i++)
+		if (ramp_trace_record(tracep, dir, words[i]) != 0)
+			return;
+}
+
 int ramp_fifo_enq(uint64_t val, ramp_chan_t *chanp)
 {
 	int ret = 0;
@@ -290,11 +1268,45 @@ int ramp_fifo_enq(uint64_t val, ramp_chan_t *chanp)
 		ret = -1;
 	else {
 		chanp->rx_buffer.buf[chanp->rx_buffer.head] = val;
+		ramp_trace_words(chanp, RAMP_TRACE_FROM_FPGA, &val, 1);
 		chanp->rx_buffer.head = (chanp->rx_buffer.head+1) % (RX_BUFFER_SIZE+1);
 	}
 	return ret;
 }
 
+/**
+ * ramp_fifo_enq_payload - unpacks the words of a data packet into the receive buffer
+ * @chanp: ramp channel struct pointer
+ * @payload: received payload
+ * @nwords: number of words in the payload
+ *
+ * The words go straight into the ring buffer, in at most two pieces.
+ *
+ * ramp_fifo_enq_payload returns 0 on success, -1 (without storing any of
+ * the words) if the receive buffer does not have room for all of them.
+ **/
+
+static int ramp_fifo_enq_payload(ramp_chan_t *chanp, const void *payload, int nwords)
+{
+	uint32_t head = chanp->rx_buffer.head;
+	int used = (head + RX_BUFFER_SIZE+1 - chanp->rx_buffer.tail) % (RX_BUFFER_SIZE+1);
+	int n;
+
+	if (nwords > RX_BUFFER_SIZE - used)
+		return -1;
+
+	n = RX_BUFFER_SIZE+1 - head;
+	if (n > nwords)
+		n = nwords;
+
+	ramp_marshal_unpack(&chanp->rx_buffer.buf[head], payload, n);
+	ramp_marshal_unpack(&chanp->rx_buffer.buf[0], (const uint8_t *) payload + 8 * n, nwords - n);
+	ramp_trace_words(chanp, RAMP_TRACE_FROM_FPGA, &chanp->rx_buffer.buf[head], n);
+	ramp_trace_words(chanp, RAMP_TRACE_FROM_FPGA, &chanp->rx_buffer.buf[0], nwords - n);
+	chanp->rx_buffer.head = (head + nwords) % (RX_BUFFER_SIZE+1);
+	return 0;
+}
+
 int ramp_fifo_deq(uint64_t *val, ramp_chan_t *chanp)
 {
 	int ret;
@@ -312,37 +1324,145 @@ int ramp_fifo_deq(uint64_t *val, ramp_chan_t *chanp)
 void *ramp_rx_thread(void *arg)
 {
 	ramp_chan_t *chanp = (ramp_chan_t *) arg;
-	ssize_t len = 0;
-	uint8_t buf[MAX_FRAME_SIZE];
-	ramp_packet_t *rx_packet;
+	ssize_t len = 0, seg, off, n;
+	uint8_t buf[UDP_SKIP_LEN + RAMP_GRO_BUFLEN];
+	char control[CMSG_SPACE(sizeof(int))];
+	struct cmsghdr *cmsg;
+	struct iovec iov;
+	struct msghdr msg;
+	int gso_size;
 
-	rx_packet = (ramp_packet_t *) buf;
-	
 	while (len != -1) {
-		len = read(chanp->socket, buf, MAX_FRAME_SIZE);
-		if (len == RAMP_PACKET_LEN && 
-		   (memcmp(&chanp->packet.src_mac_addr, &rx_packet->dest_mac_addr, MAC_ADDR_LEN) == 0) &&
-		    ntohs(rx_packet->ether_type) == RAMP_ETHERTYPE) {
-			switch (ntohs(rx_packet->packet_type)) {
-				case RAMP_TOKENTYPE: 
-					if (chanp->tx_credit == INITIAL_TX_CREDIT)
-						fprintf(stderr, "TX credit token overflow!\n");
-					else {
-						pthread_mutex_lock(&chanp->tx_credit_mutex);
-						if (chanp->tx_credit == 0) {
-							chanp->tx_credit++;
-							pthread_cond_signal(&chanp->tx_credit_cond);
-						} else
-							chanp->tx_credit++;
-						pthread_mutex_unlock(&chanp->tx_credit_mutex);
-					}														
-					break;
-				case RAMP_DATATYPE: 
-					if (ramp_fifo_enq(rx_packet->data, chanp) != 0) 
-						fprintf(stderr, "RX buffer overflow!\n");
-					break;
+		if (!chanp->udp) {
+			len = ramp_recv_frame(chanp, buf, MAX_FRAME_SIZE);
+			if (len == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+				ramp_rx_idle(chanp);
+				len = 0;
+			} else if (ramp_frame_ours(chanp, buf, len))
+				ramp_rx_packet(chanp, buf, len);
+			continue;
+		}
+
+		// coalesced datagrams arrive back to back, all of the size given
+		// in the control message except for the last
+		iov.iov_base = buf + UDP_SKIP_LEN;
+		iov.iov_len = RAMP_GRO_BUFLEN;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		len = recvmsg(chanp->socket, &msg, 0);
+		if (len == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			ramp_rx_idle(chanp);
+			len = 0;
+			continue;
+		}
+		if (len == -1)
+			break;
+
+		seg = len;
+		for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg))
+			if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+				memcpy(&gso_size, CMSG_DATA(cmsg), sizeof(int));
+				if (gso_size > 0)
+					seg = gso_size;
 			}
+
+		// each datagram is handled as a frame whose ethernet header would
+		// overlap the end of the previous one; it is never looked at
+		for (off = 0; off < len; off += seg) {
+			n = UDP_SKIP_LEN + ((len - off < seg) ? len - off : seg);
+			if (ramp_frame_ours(chanp, buf + off, n))
+				ramp_rx_packet(chanp, buf + off, n);
 		}
 	}
 	pthread_exit(NULL);
 }
+
+/**
+ * ramp_rx_idle - returns credit held back by a reader while the link is idle
+ * @chanp: ramp channel struct pointer
+ *
+ * Called by the receive thread when nothing has arrived for
+ * RAMP_CREDIT_FLUSH_MS.  If a writer holds tx_mutex, it returns the credit
+ * itself.  The thread is not cancelled by ramp_chan_close while it holds
+ * tx_mutex.
+ **/
+
+static void ramp_rx_idle(ramp_chan_t *chanp)
+{
+	int state;
+
+	if (__atomic_load_n(&chanp->rx_credit_owed, __ATOMIC_ACQUIRE) == 0)
+		return;
+
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &state);
+	if (pthread_mutex_trylock(&chanp->tx_mutex) == 0)
+		ramp_tx_unlock(chanp);
+	pthread_setcancelstate(state, NULL);
+}
+
+/**
+ * ramp_rx_packet - processes a packet received from the FPGA
+ * @chanp: ramp channel struct pointer
+ * @buf: the packet, laid out as an ethernet frame
+ * @len: length of the frame
+ **/
+
+static void ramp_rx_packet(ramp_chan_t *chanp, const uint8_t *buf, ssize_t len)
+{
+	const ramp_packet_t *rx_packet = (const ramp_packet_t *) buf;
+	uint32_t ncredits;
+	int type, payload, nbytes;
+
+	type = ntohs(rx_packet->packet_type);
+	payload = DATA_HEADER_LEN;
+
+	// data packets may return credit in a credit word ahead of the payload
+	if ((type & 0xC000) == RAMP_CREDITFLAG) {
+		if (len < DATA_HEADER_LEN + CREDIT_WORD_LEN)
+			return;
+		ramp_receive_tx_credit(chanp, (buf[16] << 8) | buf[17]);
+		type &= ~RAMP_CREDITFLAG;
+		payload += CREDIT_WORD_LEN;
+	}
+
+	switch (type) {
+		case RAMP_TOKENTYPE: 
+			// a count of zero comes from a board that sends one credit per token
+			ncredits = (chanp->caps & RAMP_CAP_CREDITS) && len >= DATA_HEADER_LEN + 2 ? (buf[16] << 8) | buf[17] : 0;
+			ramp_receive_tx_credit(chanp, ncredits ? ncredits : 1);
+			break;
+		case RAMP_BULKACKTYPE:
+			if (len < DATA_HEADER_LEN + 2)
+				break;
+			pthread_mutex_lock(&chanp->tx_credit_mutex);
+			// a stray or duplicated acknowledgement with nothing outstanding
+			// must not push the bulk credit past the FPGA's buffering
+			if (chanp->bulk_credit < RAMP_BULK_FRAMES) {
+				if (buf[16] != chanp->bulk_ack_seq || buf[17] == 0) {
+					fprintf(stderr, "Bulk packet %d was lost or dropped!\n", chanp->bulk_ack_seq);
+					chanp->bulk_error = 1;
+				}
+				chanp->bulk_ack_seq = buf[16] + 1;
+				chanp->bulk_credit++;
+				pthread_cond_broadcast(&chanp->bulk_credit_cond);
+			}
+			pthread_mutex_unlock(&chanp->tx_credit_mutex);
+			break;
+		case RAMP_CDATATYPE:
+			if (ramp_cgroup_expand(chanp, &buf[payload], len - payload) != 0)
+				fprintf(stderr, "Malformed compressed packet or RX buffer overflow!\n");
+			break;
+		default:
+			// data packets carry their length in bytes
+			nbytes = type;
+			if ((nbytes & 7) != 0 || nbytes > 8 * RAMP_FRAME_MAX_WORDS || len < payload + nbytes)
+				break;
+			if (ramp_fifo_enq_payload(chanp, &buf[payload], nbytes / 8) != 0)
+				fprintf(stderr, "RX buffer overflow!\n");
+			break;
+	}
+}
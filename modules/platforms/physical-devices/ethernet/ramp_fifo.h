@@ -33,22 +33,51 @@
 #define _RAMP_FIFO_H
 
 #include <netpacket/packet.h>
+#include <netinet/in.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <pthread.h>
 
-#define INITIAL_TX_CREDIT 	512	// size of receive buffer on FPGA side
+#include "ramp_trace.h"
+
+#define INITIAL_TX_CREDIT 	512	// size of receive buffer on FPGA side, unless its ping response advertises a window
 #define	RX_BUFFER_SIZE 		512	// size of local receive buffer (must be set on FPGA too!)
 #define RAMP_ETHERTYPE 		0x8888	// ethertype of packets sent to/from FPGA
-#define RAMP_DATATYPE 		0x0008	// indicates the packet contains 8 bytes of data
+#define RAMP_DATATYPE 		0x0008	// indicates the packet contains 8 bytes of data (multi-word data packets use 8 * nwords)
+#define RAMP_CDATATYPE 		0x0009	// indicates the packet contains a compressed group of data words
 #define RAMP_TOKENTYPE 		0xFFFF	// indicates the packet is a credit token (for flow control)
 #define RAMP_PINGTYPE 		0xFFFE	// indicates the packet is a ping request or response
+#define RAMP_BULKTYPE 		0xFFFD	// indicates the packet contains address-tagged bulk data for DDR2
+#define RAMP_BULKACKTYPE 	0xFFFC	// indicates the packet acknowledges a bulk data packet
+#define RAMP_CREDITFLAG 	0x4000	// set in the type of a data packet that returns credit in a credit word after the header
 #define MAX_FRAME_SIZE 		1518	// maximum size of an ethernet frame (assuming no jumbo frames)
 #define RAMP_PACKET_LEN 	60	// the size of all incoming packets we are interested in
 #define MAC_ADDR_LEN 		6	// MAC address length in bytes
 #define TOKEN_PACKET_LEN 	16	// length of a token packet
-#define PING_PACKET_LEN 	16	// length of a ping packet
-#define DATA_PACKET_LEN 	24	// length of a data packet
+#define PING_PACKET_LEN 	24	// length of a ping packet (including capabilities)
+#define PING_REPLY_LEN 		21	// length of a ping response, up to the end of its window
+#define DATA_HEADER_LEN 	16	// length of a data packet, excluding data words
+#define CREDIT_WORD_LEN 	8	// length of the credit word (count in the first two bytes, network order)
+#define CDATA_HEADER_LEN 	20	// length of a compressed data packet, excluding literal words
+#define BULK_HEADER_LEN 	32	// length of a bulk data packet, excluding data words
 #define RCV_SOCKBUFLEN		262144	// length of the socket receive buffer to avoid dropped packets
+#define RAMP_UDP_PORT 		34952	// default UDP port of the FPGA (0x8888)
+#define UDP_SKIP_LEN 		14	// bytes of a packet (the ethernet header) left out of its UDP encapsulation
+#define RAMP_GSO_MAX_SEGMENTS 	64	// max data packets sent in one segmentation offload send
+#define RAMP_GRO_BUFLEN 	65536	// length of the buffer for coalesced UDP receives
+
+#define RAMP_CAP_COMPRESS 	0x01	// capability bit: peer accepts compressed data packets
+#define RAMP_CAP_BULK 		0x02	// capability bit: peer accepts bulk data packets
+#define RAMP_CAP_FRAMES 	0x04	// capability bit: peer accepts multi-word data packets
+#define RAMP_CAP_CREDITS 	0x08	// capability bit: peer accepts credit words and counted tokens
+#define RAMP_LOCAL_CAPS 	(RAMP_CAP_COMPRESS | RAMP_CAP_BULK | RAMP_CAP_FRAMES | RAMP_CAP_CREDITS)	// capabilities advertised in our ping packets
+#define RAMP_FRAME_MAX_WORDS 	64	// max data words in a multi-word data packet (must be set on FPGA too!)
+#define RAMP_CGROUP_SLOTS 	8	// number of bitmap slots in a compressed data packet
+#define RAMP_CGROUP_MAX_WORDS 	64	// max words a compressed packet expands to (slots + repeats)
+#define RAMP_BULK_MAX_WORDS 	128	// max data words in a bulk packet
+#define RAMP_BULK_FRAMES 	4	// number of bulk packets buffered on FPGA side (must be set on FPGA too!)
+#define RAMP_BULK_TIMEOUT_MS 	1000	// time to wait for a bulk packet acknowledgement before giving up
+#define RAMP_CREDIT_FLUSH_MS 	10	// time the link may be idle before credit held back by a reader is returned
 
 typedef struct {
 	uint64_t buf[RX_BUFFER_SIZE+1];
@@ -64,25 +93,91 @@ typedef struct {
 	uint64_t data;
 } ramp_packet_t;
 
+// Over UDP, each datagram holds one packet from its packet type onwards,
+// i.e. without the ethernet header, and is sent to or from the FPGA's port.
+// The FPGA answers whichever address and port last pinged it.  Packets are
+// still laid out with the ethernet header internally so that both
+// encapsulations share the same code.
+
+// Data packets (plain or compressed) sent to a peer with RAMP_CAP_CREDITS
+// have RAMP_CREDITFLAG set in their type and a credit word between the
+// header and the payload, returning credit for words the sender has read.
+// Tokens sent to such a peer carry a count in the same place, so a single
+// token may return any number of credits.
+
+// Compressed data packet.  Slot i (0 <= i < nslots) holds a zero word if bit
+// (7-i) of bitmap is clear, otherwise the next word from data[].  The last
+// slot's word is then repeated another "repeat" times.  The receiver expands
+// each packet into nslots + repeat words, and each of those consumes a credit.
+
+typedef struct {
+	uint8_t dest_mac_addr[MAC_ADDR_LEN];
+	uint8_t src_mac_addr[MAC_ADDR_LEN];
+	uint16_t ether_type;
+	uint16_t packet_type;
+	uint8_t nslots;
+	uint8_t bitmap;
+	uint8_t repeat;
+	uint8_t reserved;
+	uint64_t data[RAMP_CGROUP_SLOTS];
+} __attribute__((packed)) ramp_cpacket_t;
+
+// Bulk data packet.  The data words bypass the FIFO and are written to DDR2
+// starting at byte address addr (nwords and addr are in network byte order).
+// Each packet is acknowledged by a RAMP_BULKACKTYPE packet carrying seq in
+// its first payload byte and a nonzero status in the second if the packet
+// was written (a packet rejected by the FPGA is still acknowledged, with a
+// zero status).  Bulk packets are paced by their own credit of
+// RAMP_BULK_FRAMES packets, returned by the acknowledgements.
+
+typedef struct {
+	uint8_t dest_mac_addr[MAC_ADDR_LEN];
+	uint8_t src_mac_addr[MAC_ADDR_LEN];
+	uint16_t ether_type;
+	uint16_t packet_type;
+	uint16_t nwords;
+	uint8_t seq;
+	uint8_t reserved[5];
+	uint64_t addr;
+} __attribute__((packed)) ramp_bheader_t;
+
 typedef struct {
 	int socket;
 	uint32_t tx_credit;
+	uint8_t caps;		// capabilities negotiated with the remote end at init
+	uint32_t tx_window;	// receive window of the remote end, i.e. the maximum tx_credit
+	uint32_t rx_credit_owed;	// credit for words we have read but not yet returned (atomic)
 	struct sockaddr_ll myaddr;
-	ramp_packet_t packet;	
+	int udp;		// set if packets are encapsulated in UDP (the socket is connected to the FPGA)
+	uint8_t *gso_buf;	// data packets batched for a segmentation offload send, NULL if not supported
+	ramp_packet_t packet;	// header template, read-only once the channel is up
+	pthread_mutex_t tx_mutex;	// serialises writers so each write call is contiguous on the wire
 	pthread_cond_t tx_credit_cond;
 	pthread_mutex_t tx_credit_mutex;
+	pthread_mutex_t bulk_mutex;	// serialises bulk writers so their packets go out in sequence order
+	uint32_t bulk_credit;	// bulk packets we may send before an acknowledgement
+	uint8_t bulk_seq;	// sequence number of the next bulk packet
+	uint8_t bulk_ack_seq;	// sequence number of the next expected acknowledgement
+	int bulk_error;		// set if a bulk packet was lost or dropped by the FPGA
+	pthread_cond_t bulk_credit_cond;
 	ramp_rxbuf_t rx_buffer;
 	pthread_t rx_thread;
+	ramp_trace_t *trace;	// trace recording every word sent or received, NULL if none (atomic)
 } ramp_chan_t;
 
 
 int ramp_chan_init(ramp_chan_t *chanp, const char *eth_device);
+int ramp_chan_init_udp(ramp_chan_t *chanp, const char *host, uint16_t port);
 int ramp_chan_close(ramp_chan_t *chanp);
 int ramp_chan_read8B(ramp_chan_t *chanp, void *bufp);
 int ramp_chan_write8B(ramp_chan_t *chanp, const void *bufp);
+int ramp_chan_write(ramp_chan_t *chanp, const uint64_t *bufp, int nwords);
+int ramp_chan_bulk_write(ramp_chan_t *chanp, uint64_t addr, const void *bufp, size_t len);
+int ramp_chan_bulk_load(ramp_chan_t *chanp, uint64_t addr, const char *path);
+void ramp_chan_trace(ramp_chan_t *chanp, ramp_trace_t *tracep);
 
 void *ramp_rx_thread(void *arg);
-int ramp_send_rx_token(ramp_chan_t *chanp);
+int ramp_send_rx_token(ramp_chan_t *chanp, uint32_t ncredits);
 int ramp_fifo_enq(uint64_t val, ramp_chan_t *chanp);
 int ramp_fifo_deq(uint64_t *val, ramp_chan_t *chanp);
 
@@ -0,0 +1,157 @@
+/* Copyright (c) 2009, The Regents of the University of California.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of California, Berkeley nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE REGENTS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ramp_marshal.h"
+
+#include <endian.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RAMP_MARSHAL_X86
+#include <immintrin.h>
+#endif
+
+/**
+ * ramp_marshal_swap_scalar - converts words between host and network byte order
+ * @dst: destination
+ * @src: source, may be the same as dst
+ * @nwords: number of 8 byte words to convert
+ **/
+
+static void ramp_marshal_swap_scalar(uint8_t *dst, const uint8_t *src, size_t nwords)
+{
+	uint64_t word;
+	size_t i;
+
+	for (i = 0; i < nwords; i++) {
+		memcpy(&word, src + 8 * i, 8);
+		word = htobe64(word);
+		memcpy(dst + 8 * i, &word, 8);
+	}
+}
+
+#ifdef RAMP_MARSHAL_X86
+
+/**
+ * ramp_marshal_swap_ssse3 - byte swaps words two at a time
+ * @dst: destination
+ * @src: source, may be the same as dst
+ * @nwords: number of 8 byte words available
+ *
+ * ramp_marshal_swap_ssse3 returns the number of words converted, leaving
+ * any odd word for the caller.
+ **/
+
+__attribute__((target("ssse3")))
+static size_t ramp_marshal_swap_ssse3(uint8_t *dst, const uint8_t *src, size_t nwords)
+{
+	const __m128i mask = _mm_set_epi8(8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7);
+	__m128i x;
+	size_t i;
+
+	for (i = 0; i + 2 <= nwords; i += 2) {
+		x = _mm_loadu_si128((const __m128i *) (src + 8 * i));
+		_mm_storeu_si128((__m128i *) (dst + 8 * i), _mm_shuffle_epi8(x, mask));
+	}
+
+	return i;
+}
+
+/**
+ * ramp_marshal_swap_avx2 - byte swaps words four at a time
+ * @dst: destination
+ * @src: source, may be the same as dst
+ * @nwords: number of 8 byte words available
+ *
+ * ramp_marshal_swap_avx2 returns the number of words converted, leaving
+ * up to three words for the caller.
+ **/
+
+__attribute__((target("avx2")))
+static size_t ramp_marshal_swap_avx2(uint8_t *dst, const uint8_t *src, size_t nwords)
+{
+	const __m256i mask = _mm256_set_epi8(8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7,
+					     8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7);
+	__m256i x;
+	size_t i;
+
+	for (i = 0; i + 4 <= nwords; i += 4) {
+		x = _mm256_loadu_si256((const __m256i *) (src + 8 * i));
+		_mm256_storeu_si256((__m256i *) (dst + 8 * i), _mm256_shuffle_epi8(x, mask));
+	}
+
+	return i;
+}
+
+#endif
+
+/**
+ * ramp_marshal_swap - converts words between host and network byte order
+ * @dst: destination
+ * @src: source, may be the same as dst but must not otherwise overlap it
+ * @nwords: number of 8 byte words to convert
+ *
+ * The widest vector unit the CPU supports does the bulk of the work, and
+ * the scalar loop finishes off the remainder.
+ **/
+
+static void ramp_marshal_swap(void *dst, const void *src, size_t nwords)
+{
+	size_t i = 0;
+
+#ifdef RAMP_MARSHAL_X86
+	if (__builtin_cpu_supports("avx2"))
+		i = ramp_marshal_swap_avx2(dst, src, nwords);
+	else if (__builtin_cpu_supports("ssse3"))
+		i = ramp_marshal_swap_ssse3(dst, src, nwords);
+#endif
+
+	ramp_marshal_swap_scalar((uint8_t *) dst + 8 * i, (const uint8_t *) src + 8 * i, nwords - i);
+}
+
+/**
+ * ramp_marshal_pack - packs host words into a packet payload
+ * @payload: payload to fill in
+ * @words: words to be sent
+ * @nwords: number of words
+ **/
+
+void ramp_marshal_pack(void *payload, const void *words, size_t nwords)
+{
+	ramp_marshal_swap(payload, words, nwords);
+}
+
+/**
+ * ramp_marshal_unpack - unpacks the words of a received packet payload
+ * @words: where to store the words
+ * @payload: received payload
+ * @nwords: number of words
+ **/
+
+void ramp_marshal_unpack(void *words, const void *payload, size_t nwords)
+{
+	ramp_marshal_swap(words, payload, nwords);
+}
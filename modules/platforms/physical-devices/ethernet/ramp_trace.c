@@ -0,0 +1,257 @@
+/* Copyright (c) 2009, The Regents of the University of California.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of California, Berkeley nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE REGENTS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _GNU_SOURCE
+#include "ramp_trace.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/fcntl.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+
+/**
+ * ramp_trace_create - creates a trace file and maps it for recording
+ * @tracep: trace struct
+ * @path: file to create (truncated if it exists)
+ *
+ * The file is extended and remapped in RAMP_TRACE_GROW steps as records are
+ * appended, and trimmed to its final size by ramp_trace_close.
+ *
+ * ramp_trace_create returns 0 on success, -1 on failure.
+ **/
+
+int ramp_trace_create(ramp_trace_t *tracep, const char *path)
+{
+	ramp_trace_header_t *header;
+
+	tracep->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (tracep->fd == -1) {
+		perror("open");
+		return -1;
+	}
+
+	if (ftruncate(tracep->fd, RAMP_TRACE_GROW) == -1) {
+		perror("ftruncate");
+		goto exit;
+	}
+
+	tracep->map = mmap(NULL, RAMP_TRACE_GROW, PROT_READ | PROT_WRITE, MAP_SHARED, tracep->fd, 0);
+	if (tracep->map == MAP_FAILED) {
+		perror("mmap");
+		goto exit;
+	}
+
+	header = (ramp_trace_header_t *) tracep->map;
+	memcpy(header->magic, RAMP_TRACE_MAGIC, sizeof(header->magic));
+	header->rec_size = sizeof(ramp_trace_rec_t);
+	header->nrecs = 0;
+
+	tracep->writing = 1;
+	tracep->failed = 0;
+	tracep->map_len = RAMP_TRACE_GROW;
+	tracep->nrecs = 0;
+	clock_gettime(CLOCK_MONOTONIC, &tracep->start);
+	pthread_mutex_init(&tracep->mutex, NULL);
+	return 0;
+
+exit:
+	close(tracep->fd);
+	return -1;
+}
+
+/**
+ * ramp_trace_open - maps an existing trace file for replay
+ * @tracep: trace struct
+ * @path: trace file
+ *
+ * ramp_trace_open returns 0 on success, -1 on failure.
+ **/
+
+int ramp_trace_open(ramp_trace_t *tracep, const char *path)
+{
+	ramp_trace_header_t *header;
+	struct stat st;
+
+	tracep->fd = open(path, O_RDONLY);
+	if (tracep->fd == -1) {
+		perror("open");
+		return -1;
+	}
+
+	if (fstat(tracep->fd, &st) == -1) {
+		perror("fstat");
+		goto exit;
+	}
+
+	if (st.st_size < (off_t) sizeof(ramp_trace_header_t)) {
+		fprintf(stderr, "%s is not a channel trace\n", path);
+		goto exit;
+	}
+
+	tracep->map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, tracep->fd, 0);
+	if (tracep->map == MAP_FAILED) {
+		perror("mmap");
+		goto exit;
+	}
+
+	header = (ramp_trace_header_t *) tracep->map;
+	if (memcmp(header->magic, RAMP_TRACE_MAGIC, sizeof(header->magic)) != 0 ||
+	    header->rec_size != sizeof(ramp_trace_rec_t) ||
+	    sizeof(ramp_trace_header_t) + header->nrecs * sizeof(ramp_trace_rec_t) > (uint64_t) st.st_size) {
+		fprintf(stderr, "%s is not a channel trace or is truncated\n", path);
+		munmap(tracep->map, st.st_size);
+		goto exit;
+	}
+
+	madvise(tracep->map, st.st_size, MADV_SEQUENTIAL);
+
+	tracep->writing = 0;
+	tracep->failed = 0;
+	tracep->map_len = st.st_size;
+	tracep->nrecs = header->nrecs;
+	clock_gettime(CLOCK_MONOTONIC, &tracep->start);
+	pthread_mutex_init(&tracep->mutex, NULL);
+	return 0;
+
+exit:
+	close(tracep->fd);
+	return -1;
+}
+
+/**
+ * ramp_trace_close - unmaps a trace, trimming it to the records written
+ * @tracep: trace struct
+ *
+ * ramp_trace_close returns 0 on success, -1 on failure.
+ **/
+
+int ramp_trace_close(ramp_trace_t *tracep)
+{
+	int ret = 0;
+
+	if (tracep->writing) {
+		((ramp_trace_header_t *) tracep->map)->nrecs = tracep->nrecs;
+		munmap(tracep->map, tracep->map_len);
+		if (ftruncate(tracep->fd, sizeof(ramp_trace_header_t) + tracep->nrecs * sizeof(ramp_trace_rec_t)) == -1) {
+			perror("ftruncate");
+			ret = -1;
+		}
+	} else
+		munmap(tracep->map, tracep->map_len);
+
+	close(tracep->fd);
+	pthread_mutex_destroy(&tracep->mutex);
+	return ret;
+}
+
+/**
+ * ramp_trace_now - time since the trace was opened
+ * @tracep: trace struct
+ *
+ * ramp_trace_now returns the time in nanoseconds.
+ **/
+
+uint64_t ramp_trace_now(ramp_trace_t *tracep)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) (now.tv_sec - tracep->start.tv_sec) * 1000000000ULL + now.tv_nsec - tracep->start.tv_nsec;
+}
+
+/**
+ * ramp_trace_record - appends a record to a trace
+ * @tracep: trace struct
+ * @dir: RAMP_TRACE_TO_FPGA or RAMP_TRACE_FROM_FPGA
+ * @data: channel word
+ *
+ * Once a record cannot be written, the trace stops growing, so that it
+ * always holds every word up to the failure and nothing after it.  The
+ * header's count is kept up to date, so a trace left behind by a crash
+ * still reads back up to its last record.
+ *
+ * ramp_trace_record returns 0 on success, -1 if the trace could not be
+ * extended or has already failed.
+ **/
+
+int ramp_trace_record(ramp_trace_t *tracep, int dir, uint64_t data)
+{
+	ramp_trace_rec_t *rec;
+	size_t offset;
+	uint8_t *map;
+
+	pthread_mutex_lock(&tracep->mutex);
+
+	if (tracep->failed) {
+		pthread_mutex_unlock(&tracep->mutex);
+		return -1;
+	}
+
+	offset = sizeof(ramp_trace_header_t) + tracep->nrecs * sizeof(ramp_trace_rec_t);
+	if (offset + sizeof(ramp_trace_rec_t) > tracep->map_len) {
+		if (ftruncate(tracep->fd, tracep->map_len + RAMP_TRACE_GROW) == -1) {
+			perror("ftruncate");
+			tracep->failed = 1;
+			pthread_mutex_unlock(&tracep->mutex);
+			return -1;
+		}
+		map = mremap(tracep->map, tracep->map_len, tracep->map_len + RAMP_TRACE_GROW, MREMAP_MAYMOVE);
+		if (map == MAP_FAILED) {
+			perror("mremap");
+			tracep->failed = 1;
+			pthread_mutex_unlock(&tracep->mutex);
+			return -1;
+		}
+		tracep->map = map;
+		tracep->map_len += RAMP_TRACE_GROW;
+	}
+
+	rec = (ramp_trace_rec_t *) (tracep->map + offset);
+	rec->data = data;
+	rec->stamp = (ramp_trace_now(tracep) << 1) | (dir & 1);
+	tracep->nrecs++;
+	((ramp_trace_header_t *) tracep->map)->nrecs = tracep->nrecs;
+
+	pthread_mutex_unlock(&tracep->mutex);
+	return 0;
+}
+
+/**
+ * ramp_trace_get - returns a record of a trace opened for replay
+ * @tracep: trace struct
+ * @idx: record index
+ *
+ * ramp_trace_get returns NULL past the end of the trace.
+ **/
+
+const ramp_trace_rec_t *ramp_trace_get(ramp_trace_t *tracep, uint64_t idx)
+{
+	if (idx >= tracep->nrecs)
+		return NULL;
+	return (const ramp_trace_rec_t *) (tracep->map + sizeof(ramp_trace_header_t)) + idx;
+}
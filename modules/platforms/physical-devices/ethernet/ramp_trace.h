@@ -0,0 +1,76 @@
+/* Copyright (c) 2009, The Regents of the University of California.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of California, Berkeley nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE REGENTS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _RAMP_TRACE_H
+#define _RAMP_TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <time.h>
+
+#define RAMP_TRACE_MAGIC 	"RAMPTRC1"	// identifies a channel trace file
+#define RAMP_TRACE_GROW 	(64 << 20)	// size by which the trace file is extended when full
+#define RAMP_TRACE_TO_FPGA 	0		// record direction: host to FPGA
+#define RAMP_TRACE_FROM_FPGA 	1		// record direction: FPGA to host
+
+// A trace file is a header followed by fixed size records, one per channel
+// word, in the order they passed through the device.  The stamp holds the
+// time in nanoseconds since the trace was opened, shifted left by one, with
+// the direction in the low bit.
+
+typedef struct {
+	char magic[8];
+	uint32_t rec_size;
+	uint32_t reserved;
+	uint64_t nrecs;
+	uint64_t pad;
+} ramp_trace_header_t;
+
+typedef struct {
+	uint64_t data;
+	uint64_t stamp;
+} ramp_trace_rec_t;
+
+typedef struct {
+	int fd;
+	int writing;
+	int failed;		// set once a record could not be written
+	uint8_t *map;
+	size_t map_len;
+	uint64_t nrecs;
+	struct timespec start;
+	pthread_mutex_t mutex;
+} ramp_trace_t;
+
+int ramp_trace_create(ramp_trace_t *tracep, const char *path);
+int ramp_trace_open(ramp_trace_t *tracep, const char *path);
+int ramp_trace_close(ramp_trace_t *tracep);
+int ramp_trace_record(ramp_trace_t *tracep, int dir, uint64_t data);
+const ramp_trace_rec_t *ramp_trace_get(ramp_trace_t *tracep, uint64_t idx);
+uint64_t ramp_trace_now(ramp_trace_t *tracep);
+
+#endif
@@ -123,6 +123,19 @@ module EthernetFIFOLoopback(
 			.D_OUT				(data_out),
 			.DEQ				(deq),
 			.EMPTY_N			(empty_n),
+			.BULK_ADDR			(),
+			.BULK_D_OUT			(),
+			.BULK_DEQ			(1'b0),
+			.BULK_EMPTY_N			(),
+			.SPILL_WR_ADDR			(),
+			.SPILL_WR_DATA			(),
+			.SPILL_WR_DEQ			(1'b0),
+			.SPILL_WR_EMPTY_N		(),
+			.SPILL_RD_ADDR			(),
+			.SPILL_RD_DEQ			(1'b0),
+			.SPILL_RD_EMPTY_N		(),
+			.SPILL_RSP_DATA			(64'h0),
+			.SPILL_RSP_ENQ			(1'b0),
 			.CLK_100			(CLK_100),
 			.PHY_TXD			(PHY_TXD),
 			.PHY_TXEN			(PHY_TXEN),
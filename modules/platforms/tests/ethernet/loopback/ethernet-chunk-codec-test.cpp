@@ -0,0 +1,120 @@
+//
+// Chunk codec test: round trips chunks narrower than, as wide as and wider
+// than a 64 bit word through ETHERNET_CHUNK_CODEC, and checks that a wide
+// chunk's words go out most significant first, zero extended, as the
+// hardware side of the channel expects them.
+//
+//	g++ -I../../../channelio/physical-channel/ethernet -o ethernet-chunk-codec-test ethernet-chunk-codec-test.cpp
+//
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef uint64_t UINT64;
+
+#include "ethernet-chunk-codec.h"
+
+static int errors = 0;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok)
+    {
+        fprintf(stderr, "FAIL: %s\n", what);
+        errors++;
+    }
+}
+
+// a chunk wider than any scalar, least significant part first in memory
+template <size_t PARTS, typename PART>
+struct WIDE_CHUNK
+{
+    PART part[PARTS];
+};
+
+// sets part i of a wide chunk from a pattern that differs in every byte
+template <size_t PARTS, typename PART>
+static WIDE_CHUNK<PARTS, PART> pattern(UINT64 seed)
+{
+    WIDE_CHUNK<PARTS, PART> chunk;
+    for (size_t i = 0; i < PARTS; i++)
+    {
+        chunk.part[i] = PART((seed + i) * 0x0101010101010101ULL + 0x0001020304050607ULL);
+    }
+    return chunk;
+}
+
+template <size_t PARTS, typename PART>
+static void check_wide(const char *name)
+{
+    typedef WIDE_CHUNK<PARTS, PART> CHUNK;
+    const size_t WORDS = (sizeof(CHUNK) + sizeof(UINT64) - 1) / sizeof(UINT64);
+    const size_t PER_WORD = sizeof(UINT64) / sizeof(PART);
+    UINT64 words[WORDS];
+    char what[128];
+
+    for (UINT64 seed = 0; seed < 64; seed++)
+    {
+        CHUNK chunk = pattern<PARTS, PART>(seed);
+        ETHERNET_CHUNK_CODEC<WORDS, CHUNK>::Encode(chunk, words);
+
+        // word WORDS-1-w holds parts w*PER_WORD onwards, zero extended
+        for (size_t w = 0; w < WORDS; w++)
+        {
+            UINT64 expect = 0;
+            for (size_t p = 0; p < PER_WORD && w * PER_WORD + p < PARTS; p++)
+            {
+                expect |= UINT64(chunk.part[w * PER_WORD + p]) << (8 * sizeof(PART) * p);
+            }
+            snprintf(what, sizeof(what), "%s: word %zu of seed %llu", name, WORDS - 1 - w, (unsigned long long) seed);
+            check(words[WORDS - 1 - w] == expect, what);
+        }
+
+        CHUNK back = ETHERNET_CHUNK_CODEC<WORDS, CHUNK>::Decode(words);
+        snprintf(what, sizeof(what), "%s: round trip of seed %llu", name, (unsigned long long) seed);
+        check(memcmp(&back, &chunk, sizeof(CHUNK)) == 0, what);
+    }
+}
+
+template <typename CHUNK>
+static void check_narrow(const char *name)
+{
+    UINT64 word;
+    char what[128];
+
+    for (UINT64 seed = 0; seed < 64; seed++)
+    {
+        CHUNK chunk = CHUNK(seed * 0x0123456789ABCDEFULL);
+        ETHERNET_CHUNK_CODEC<1, CHUNK>::Encode(chunk, &word);
+        snprintf(what, sizeof(what), "%s: seed %llu", name, (unsigned long long) seed);
+        check(word == UINT64(chunk) && ETHERNET_CHUNK_CODEC<1, CHUNK>::Decode(&word) == chunk, what);
+    }
+}
+
+int main()
+{
+    check_narrow<uint8_t>("8 bit chunk");
+    check_narrow<uint32_t>("32 bit chunk");
+    check_narrow<UINT64>("64 bit chunk");
+
+    check_wide<3, uint32_t>("96 bit chunk");
+    check_wide<2, UINT64>("128 bit chunk");
+    check_wide<5, uint32_t>("160 bit chunk");
+    check_wide<4, UINT64>("256 bit chunk");
+
+#ifdef __SIZEOF_INT128__
+    // a native 128 bit chunk splits into its high then its low half
+    unsigned __int128 chunk = (unsigned __int128) 0x0011223344556677ULL << 64 | 0x8899AABBCCDDEEFFULL;
+    UINT64 words[2];
+    ETHERNET_CHUNK_CODEC<2, unsigned __int128>::Encode(chunk, words);
+    check(words[0] == 0x0011223344556677ULL && words[1] == 0x8899AABBCCDDEEFFULL, "native 128 bit chunk: word order");
+    check(ETHERNET_CHUNK_CODEC<2, unsigned __int128>::Decode(words) == chunk, "native 128 bit chunk: round trip");
+#endif
+
+    if (errors == 0)
+    {
+        printf("Test succeeded\n");
+    }
+    return errors ? -1 : 0;
+}
@@ -0,0 +1,163 @@
+/*
+ * Bulk write test: runs ramp_chan_bulk_write against a board model on the
+ * loopback interface, which stores bulk packets in a DDR2 array and
+ * acknowledges them.  The model can lose an acknowledgement, reject a
+ * packet or send an acknowledgement nobody asked for, and each write after
+ * such a failure must succeed again.
+ *
+ *	gcc -I../../../physical-devices/ethernet -o ramp_bulk_test ramp_bulk_test.c \
+ *		../../../physical-devices/ethernet/ramp_fifo.c \
+ *		../../../physical-devices/ethernet/ramp_marshal.c \
+ *		../../../physical-devices/ethernet/ramp_trace.c -lpthread
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <endian.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include "ramp_fifo.h"
+
+#define DDR2_WORDS	8192
+
+enum { BOARD_ACK, BOARD_LOSE_ACK, BOARD_REJECT };
+
+static uint64_t ddr2[DDR2_WORDS];
+static volatile int board_mode = BOARD_ACK;
+static int board_sock;
+static struct sockaddr_in host_addr;
+
+static void board_send(const uint8_t *pkt, size_t len)
+{
+	sendto(board_sock, pkt, len, 0, (struct sockaddr *) &host_addr, sizeof(host_addr));
+}
+
+static void board_ack(uint8_t seq, uint8_t status)
+{
+	uint8_t ack[10] = { RAMP_BULKACKTYPE >> 8, RAMP_BULKACKTYPE & 0xFF, seq, status };
+
+	board_send(ack, sizeof(ack));
+}
+
+// the board answers pings, and stores and acknowledges bulk packets
+static void *board_thread(void *arg)
+{
+	uint8_t buf[MAX_FRAME_SIZE];
+	uint8_t ping[8] = { RAMP_PINGTYPE >> 8, RAMP_PINGTYPE & 0xFF, RAMP_CAP_BULK, 0, 0, 0x02, 0x00 };
+	socklen_t alen;
+	ssize_t len;
+	uint64_t addr;
+	int type, nwords, mode;
+
+	(void) arg;
+	for (;;) {
+		alen = sizeof(host_addr);
+		len = recvfrom(board_sock, buf, sizeof(buf), 0, (struct sockaddr *) &host_addr, &alen);
+		if (len < 2)
+			continue;
+
+		type = (buf[0] << 8) | buf[1];
+		if (type == RAMP_PINGTYPE) {
+			board_send(ping, sizeof(ping));
+			continue;
+		}
+		if (type != RAMP_BULKTYPE || len < BULK_HEADER_LEN - UDP_SKIP_LEN)
+			continue;
+
+		nwords = (buf[2] << 8) | buf[3];
+		memcpy(&addr, &buf[10], 8);
+		addr = be64toh(addr) / 8;
+
+		// each failure mode applies to a single packet
+		mode = board_mode;
+		board_mode = BOARD_ACK;
+		if (mode == BOARD_LOSE_ACK)
+			continue;
+		if (mode == BOARD_REJECT || addr + nwords > DDR2_WORDS) {
+			board_ack(buf[4], 0);
+			continue;
+		}
+
+		memcpy(&ddr2[addr], &buf[BULK_HEADER_LEN - UDP_SKIP_LEN], 8 * nwords);
+		board_ack(buf[4], 1);
+	}
+	return NULL;
+}
+
+static int check_write(ramp_chan_t *chanp, const char *what, int mode, int expect)
+{
+	static uint64_t data[4 * RAMP_BULK_MAX_WORDS * RAMP_BULK_FRAMES];
+	static uint64_t fill;
+	size_t i;
+	int ret;
+
+	for (i = 0; i < sizeof(data) / 8; i++)
+		data[i] = ++fill;
+	memset(ddr2, 0, sizeof(ddr2));
+
+	board_mode = mode;
+	ret = ramp_chan_bulk_write(chanp, 8 * 16, data, sizeof(data) - 4);
+	if (ret != expect) {
+		fprintf(stderr, "%s: ramp_chan_bulk_write returned %d, expected %d\n", what, ret, expect);
+		return 1;
+	}
+
+	if (ret == 0) {
+		// the last word is padded with zeros
+		data[sizeof(data) / 8 - 1] &= htobe64(0xFFFFFFFF00000000ULL);
+		if (memcmp(&ddr2[16], data, sizeof(data)) != 0) {
+			fprintf(stderr, "%s: wrong data in DDR2\n", what);
+			return 1;
+		}
+	}
+
+	if (chanp->bulk_credit > RAMP_BULK_FRAMES) {
+		fprintf(stderr, "%s: bulk credit %u exceeds the FPGA's %d frames\n", what, chanp->bulk_credit, RAMP_BULK_FRAMES);
+		return 1;
+	}
+	return 0;
+}
+
+int main(void)
+{
+	ramp_chan_t channel;
+	struct sockaddr_in addr;
+	pthread_t board;
+	int errors = 0;
+
+	board_sock = socket(AF_INET, SOCK_DGRAM, 0);
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(RAMP_UDP_PORT);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(board_sock, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+		perror("bind");
+		return -1;
+	}
+	pthread_create(&board, NULL, board_thread, NULL);
+
+	if (ramp_chan_init_udp(&channel, "127.0.0.1", RAMP_UDP_PORT) != 0) {
+		fprintf(stderr, "Error initializing channel\n");
+		return -1;
+	}
+
+	errors += check_write(&channel, "acknowledged", BOARD_ACK, 0);
+	errors += check_write(&channel, "lost acknowledgement", BOARD_LOSE_ACK, -1);
+	errors += check_write(&channel, "after a lost acknowledgement", BOARD_ACK, 0);
+	errors += check_write(&channel, "rejected", BOARD_REJECT, -1);
+	errors += check_write(&channel, "after a rejected packet", BOARD_ACK, 0);
+
+	// an acknowledgement with nothing outstanding is ignored
+	board_ack(0x55, 1);
+	usleep(100000);
+	errors += check_write(&channel, "after a stray acknowledgement", BOARD_ACK, 0);
+
+	if (errors == 0)
+		printf("Test succeeded\n");
+
+	ramp_chan_close(&channel);
+	return errors ? -1 : 0;
+}
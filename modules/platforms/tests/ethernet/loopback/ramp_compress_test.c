@@ -0,0 +1,231 @@
+/*
+ * Compression test: writes words of varying compressibility through a
+ * channel to a board model on the loopback interface.  The model expands
+ * each packet the way the FPGA does, then echoes it unchanged, so the words
+ * are checked both as the FPGA decodes them and after the host's own
+ * expansion.  Runs of zeros and repeats must go out compressed, and words
+ * that do not compress must go out as plain data packets.
+ *
+ *	gcc -I../../../physical-devices/ethernet -o ramp_compress_test ramp_compress_test.c \
+ *		../../../physical-devices/ethernet/ramp_fifo.c \
+ *		../../../physical-devices/ethernet/ramp_marshal.c \
+ *		../../../physical-devices/ethernet/ramp_trace.c -lpthread
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <endian.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include "ramp_fifo.h"
+
+#define MAX_WORDS	256
+
+enum { ZEROS, RUNS, SPARSE, RANDOM, MIXED, NPATTERNS };
+static const char *pattern_name[NPATTERNS] = { "zeros", "runs", "sparse", "random", "mixed" };
+
+static int board_sock;
+static struct sockaddr_in host_addr;
+static uint64_t board_words[MAX_WORDS];
+static volatile int nboard_words;
+static volatile int ncdata;
+static volatile int board_error;
+
+static void board_send(const uint8_t *pkt, size_t len)
+{
+	sendto(board_sock, pkt, len, 0, (struct sockaddr *) &host_addr, sizeof(host_addr));
+}
+
+static void board_take(uint64_t word)
+{
+	if (nboard_words < MAX_WORDS)
+		board_words[nboard_words] = word;
+	nboard_words++;
+}
+
+// expands a compressed group as the FPGA does, returning the number of
+// words or -1 if the group is malformed
+static int board_expand(const uint8_t *group, ssize_t len)
+{
+	int nslots = group[0], bitmap = group[1], repeat = group[2];
+	int i, nlit = 0;
+	uint64_t word = 0;
+
+	if (nslots < 1 || nslots > RAMP_CGROUP_SLOTS || nslots + repeat > RAMP_CGROUP_MAX_WORDS ||
+	    len != 4 + 8 * __builtin_popcount(bitmap))
+		return -1;
+
+	for (i = 0; i < nslots; i++) {
+		word = 0;
+		if (bitmap & (0x80 >> i)) {
+			memcpy(&word, &group[4 + 8 * nlit++], 8);
+			word = be64toh(word);
+		}
+		board_take(word);
+	}
+	for (i = 0; i < repeat; i++)
+		board_take(word);
+	return nslots + repeat;
+}
+
+// the board answers pings, and decodes and echoes data packets
+static void *board_thread(void *arg)
+{
+	uint8_t buf[MAX_FRAME_SIZE];
+	uint8_t ping[8] = { RAMP_PINGTYPE >> 8, RAMP_PINGTYPE & 0xFF,
+			    RAMP_CAP_COMPRESS | RAMP_CAP_FRAMES | RAMP_CAP_CREDITS, 0, 0, 0x02, 0x00 };
+	uint8_t token[10] = { RAMP_TOKENTYPE >> 8, RAMP_TOKENTYPE & 0xFF };
+	const uint8_t *body;
+	socklen_t alen;
+	ssize_t len;
+	uint64_t word;
+	int type, i, n;
+
+	(void) arg;
+	for (;;) {
+		alen = sizeof(host_addr);
+		len = recvfrom(board_sock, buf, sizeof(buf), 0, (struct sockaddr *) &host_addr, &alen);
+		if (len < 2)
+			continue;
+
+		type = (buf[0] << 8) | buf[1];
+		if (type == RAMP_PINGTYPE) {
+			board_send(ping, sizeof(ping));
+			continue;
+		}
+		if (type == RAMP_TOKENTYPE || !(type & RAMP_CREDITFLAG) || len < 2 + CREDIT_WORD_LEN) {
+			if (type != RAMP_TOKENTYPE)
+				board_error = 1;
+			continue;
+		}
+
+		type &= ~RAMP_CREDITFLAG;
+		body = &buf[2 + CREDIT_WORD_LEN];
+		len -= 2 + CREDIT_WORD_LEN;
+		if (type == RAMP_CDATATYPE) {
+			ncdata++;
+			n = board_expand(body, len);
+		} else if (type % RAMP_DATATYPE == 0 && type / 8 <= RAMP_FRAME_MAX_WORDS && len == type) {
+			n = type / 8;
+			for (i = 0; i < n; i++) {
+				memcpy(&word, &body[8 * i], 8);
+				board_take(be64toh(word));
+			}
+		} else
+			n = -1;
+		if (n < 0) {
+			board_error = 1;
+			continue;
+		}
+
+		// echo the packet without the host's credit, which is not ours to
+		// return, then return the credit for its words
+		memset(&buf[2], 0, CREDIT_WORD_LEN);
+		board_send(buf, 2 + CREDIT_WORD_LEN + len);
+		token[2] = n >> 8;
+		token[3] = n;
+		board_send(token, sizeof(token));
+	}
+	return NULL;
+}
+
+static uint64_t pattern_word(int pattern, int i)
+{
+	static const uint64_t mix = 0x9E3779B97F4A7C15ULL;
+
+	switch (pattern) {
+		case ZEROS:
+			return 0;
+		case RUNS:
+			return 0x1111111111111111ULL * (i / 37 + 1);
+		case SPARSE:
+			return (i % 5 == 0) ? mix * (i + 1) : 0;
+		case RANDOM:
+			return (mix * (i + 1)) | 1;
+		default:
+			return ((i / 100) % 3 == 0) ? mix * (i + 1) | 1 : ((i / 100) % 3 == 1) ? 0 : (uint64_t) (i / 13);
+	}
+}
+
+static int check_pattern(ramp_chan_t *chanp, int pattern, int nwords)
+{
+	uint64_t words[MAX_WORDS], word;
+	int i, got, spins, cdata_before = ncdata;
+
+	for (i = 0; i < nwords; i++)
+		words[i] = pattern_word(pattern, i);
+	nboard_words = 0;
+
+	if (ramp_chan_write(chanp, words, nwords) != nwords) {
+		fprintf(stderr, "%s, %d words: error writing to channel\n", pattern_name[pattern], nwords);
+		return 1;
+	}
+
+	for (got = 0, spins = 0; got < nwords && spins < 1000000; spins++) {
+		if (ramp_chan_read8B(chanp, &word) != 8)
+			continue;
+		if (word != words[got]) {
+			fprintf(stderr, "%s, %d words: word %d echoed as %016llx, sent %016llx\n", pattern_name[pattern],
+				nwords, got, (unsigned long long) word, (unsigned long long) words[got]);
+			return 1;
+		}
+		got++;
+	}
+	usleep(1000);
+
+	if (got != nwords || nboard_words != nwords || memcmp(board_words, words, 8 * nwords) != 0 || board_error) {
+		fprintf(stderr, "%s, %d words: %d echoed, %d decoded by the board%s\n", pattern_name[pattern], nwords,
+			got, nboard_words, board_error ? ", malformed packets" : "");
+		return 1;
+	}
+	if (pattern == RANDOM && ncdata != cdata_before) {
+		fprintf(stderr, "random, %d words: incompressible words sent compressed\n", nwords);
+		return 1;
+	}
+	if ((pattern == ZEROS || pattern == RUNS) && nwords > 1 && ncdata == cdata_before) {
+		fprintf(stderr, "%s, %d words: nothing sent compressed\n", pattern_name[pattern], nwords);
+		return 1;
+	}
+	return 0;
+}
+
+int main(void)
+{
+	ramp_chan_t channel;
+	struct sockaddr_in addr;
+	pthread_t board;
+	int pattern, nwords, errors = 0;
+
+	board_sock = socket(AF_INET, SOCK_DGRAM, 0);
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(RAMP_UDP_PORT);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(board_sock, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+		perror("bind");
+		return -1;
+	}
+	pthread_create(&board, NULL, board_thread, NULL);
+
+	if (ramp_chan_init_udp(&channel, "127.0.0.1", RAMP_UDP_PORT) != 0) {
+		fprintf(stderr, "Error initializing channel\n");
+		return -1;
+	}
+	if (!(channel.caps & RAMP_CAP_COMPRESS)) {
+		fprintf(stderr, "Compression not negotiated\n");
+		return -1;
+	}
+
+	for (pattern = 0; pattern < NPATTERNS; pattern++)
+		for (nwords = 1; nwords <= MAX_WORDS; nwords += (nwords < 80) ? 1 : 44)
+			errors += check_pattern(&channel, pattern, nwords);
+
+	if (errors == 0)
+		printf("Test succeeded\n");
+
+	ramp_chan_close(&channel);
+	return errors ? -1 : 0;
+}
@@ -0,0 +1,202 @@
+/*
+ * Concurrent writer test: several threads write messages through one
+ * channel to a board model on the loopback interface, which checks that the
+ * words of each ramp_chan_write call arrive contiguously and that each
+ * thread's calls arrive in order.  Messages mix tagged words with zeros, so
+ * compressed and plain packets interleave, and the board's window is small,
+ * so writers keep waiting for credit.
+ *
+ *	gcc -I../../../physical-devices/ethernet -o ramp_concurrent_test ramp_concurrent_test.c \
+ *		../../../physical-devices/ethernet/ramp_fifo.c \
+ *		../../../physical-devices/ethernet/ramp_marshal.c \
+ *		../../../physical-devices/ethernet/ramp_trace.c -lpthread
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <endian.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include "ramp_fifo.h"
+
+#define NTHREADS	4
+#define NCALLS		500
+#define MAX_MSG_WORDS	150
+#define BOARD_WINDOW	64
+
+// word j of call c of thread t, of n words; every third word is zero
+#define TAG(t, n, c, j)	(((uint64_t) (t) + 1) << 56 | (uint64_t) (n) << 40 | (uint64_t) (c) << 16 | (j))
+#define TAG_ZERO(j)	((j) % 3 == 2)
+
+static ramp_chan_t channel;
+static int board_sock;
+static struct sockaddr_in host_addr;
+static volatile int board_errors, board_msgs;
+
+// the board's view of the message in progress
+static int cur_thread = -1, cur_words, cur_call, cur_word;
+static int next_call[NTHREADS];
+
+static void board_send(const uint8_t *pkt, size_t len)
+{
+	sendto(board_sock, pkt, len, 0, (struct sockaddr *) &host_addr, sizeof(host_addr));
+}
+
+static void board_error(const char *what, uint64_t word)
+{
+	if (board_errors++ < 5)
+		fprintf(stderr, "board: %s at word %016llx\n", what, (unsigned long long) word);
+}
+
+// checks the next word against the message in progress
+static void board_take(uint64_t word)
+{
+	int t;
+
+	if (cur_thread < 0) {
+		t = (word >> 56) - 1;
+		if (word == 0 || t < 0 || t >= NTHREADS || (word & 0xFFFF) != 0) {
+			board_error("message does not start with a tag", word);
+			return;
+		}
+		cur_thread = t;
+		cur_words = (word >> 40) & 0xFFFF;
+		cur_call = (word >> 16) & 0xFFFFFF;
+		cur_word = 0;
+		if (cur_call != next_call[t])
+			board_error("thread's messages out of order", word);
+		next_call[t] = cur_call + 1;
+	} else if (word != (TAG_ZERO(cur_word) ? 0 : TAG(cur_thread, cur_words, cur_call, cur_word)))
+		board_error("message interleaved with another", word);
+
+	if (++cur_word == cur_words) {
+		cur_thread = -1;
+		board_msgs++;
+	}
+}
+
+static int board_expand(const uint8_t *group)
+{
+	int nslots = group[0], bitmap = group[1], repeat = group[2];
+	int i, nlit = 0;
+	uint64_t word = 0;
+
+	for (i = 0; i < nslots; i++) {
+		word = 0;
+		if (bitmap & (0x80 >> i)) {
+			memcpy(&word, &group[4 + 8 * nlit++], 8);
+			word = be64toh(word);
+		}
+		board_take(word);
+	}
+	for (i = 0; i < repeat; i++)
+		board_take(word);
+	return nslots + repeat;
+}
+
+// the board answers pings, and takes data packets, returning their credit
+static void *board_thread(void *arg)
+{
+	uint8_t buf[MAX_FRAME_SIZE];
+	uint8_t ping[8] = { RAMP_PINGTYPE >> 8, RAMP_PINGTYPE & 0xFF,
+			    RAMP_CAP_COMPRESS | RAMP_CAP_FRAMES | RAMP_CAP_CREDITS, 0, 0, 0, BOARD_WINDOW };
+	uint8_t token[10] = { RAMP_TOKENTYPE >> 8, RAMP_TOKENTYPE & 0xFF };
+	const uint8_t *body;
+	socklen_t alen;
+	ssize_t len;
+	uint64_t word;
+	int type, i, n;
+
+	(void) arg;
+	for (;;) {
+		alen = sizeof(host_addr);
+		len = recvfrom(board_sock, buf, sizeof(buf), 0, (struct sockaddr *) &host_addr, &alen);
+		if (len < 2)
+			continue;
+
+		type = (buf[0] << 8) | buf[1];
+		if (type == RAMP_PINGTYPE) {
+			board_send(ping, sizeof(ping));
+			continue;
+		}
+		if (type == RAMP_TOKENTYPE || !(type & RAMP_CREDITFLAG))
+			continue;
+
+		type &= ~RAMP_CREDITFLAG;
+		body = &buf[2 + CREDIT_WORD_LEN];
+		if (type == RAMP_CDATATYPE)
+			n = board_expand(body);
+		else {
+			n = type / 8;
+			for (i = 0; i < n; i++) {
+				memcpy(&word, &body[8 * i], 8);
+				board_take(be64toh(word));
+			}
+		}
+
+		token[2] = n >> 8;
+		token[3] = n;
+		board_send(token, sizeof(token));
+	}
+	return NULL;
+}
+
+static void *writer_thread(void *arg)
+{
+	int t = (int) (long) arg;
+	uint64_t words[MAX_MSG_WORDS];
+	int c, j, n;
+
+	for (c = 0; c < NCALLS; c++) {
+		n = 1 + (c * 37 + t * 11) % MAX_MSG_WORDS;
+		for (j = 0; j < n; j++)
+			words[j] = TAG_ZERO(j) ? 0 : TAG(t, n, c, j);
+		if (ramp_chan_write(&channel, words, n) != n) {
+			fprintf(stderr, "thread %d: error writing to channel\n", t);
+			break;
+		}
+	}
+	return NULL;
+}
+
+int main(void)
+{
+	struct sockaddr_in addr;
+	pthread_t board, writers[NTHREADS];
+	long t;
+
+	board_sock = socket(AF_INET, SOCK_DGRAM, 0);
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(RAMP_UDP_PORT);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(board_sock, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+		perror("bind");
+		return -1;
+	}
+	pthread_create(&board, NULL, board_thread, NULL);
+
+	if (ramp_chan_init_udp(&channel, "127.0.0.1", RAMP_UDP_PORT) != 0) {
+		fprintf(stderr, "Error initializing channel\n");
+		return -1;
+	}
+
+	alarm(60);
+	for (t = 0; t < NTHREADS; t++)
+		pthread_create(&writers[t], NULL, writer_thread, (void *) t);
+	for (t = 0; t < NTHREADS; t++)
+		pthread_join(writers[t], NULL);
+	usleep(200000);
+
+	if (board_msgs != NTHREADS * NCALLS || board_errors) {
+		fprintf(stderr, "%d of %d messages received, %d errors\n", board_msgs, NTHREADS * NCALLS, board_errors);
+		return -1;
+	}
+
+	printf("Test succeeded\n");
+	ramp_chan_close(&channel);
+	return 0;
+}
@@ -0,0 +1,176 @@
+/*
+ * Credit test: runs the channel against a board model on the loopback
+ * interface that takes credit words and counted tokens.  The board sends
+ * words that are only partly read, and the credit for those read must come
+ * back even though the reader stops.  It then takes more words than its
+ * window from the host, returning the credit for each packet in a single
+ * counted token, and every credit read must come back exactly once, in
+ * tokens or in the credit words of the host's data packets.
+ *
+ *	gcc -I../../../physical-devices/ethernet -o ramp_credit_test ramp_credit_test.c \
+ *		../../../physical-devices/ethernet/ramp_fifo.c \
+ *		../../../physical-devices/ethernet/ramp_marshal.c \
+ *		../../../physical-devices/ethernet/ramp_trace.c -lpthread
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <endian.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include "ramp_fifo.h"
+
+#define BOARD_WINDOW	16
+#define BOARD_WORDS	300
+#define HOST_WORDS	(8 * BOARD_WINDOW)
+
+static int board_sock;
+static struct sockaddr_in host_addr;
+static volatile uint32_t returned;	// credit the host has returned to the board
+static uint64_t received[HOST_WORDS];
+static volatile int nreceived;
+
+static void board_send(const uint8_t *pkt, size_t len)
+{
+	sendto(board_sock, pkt, len, 0, (struct sockaddr *) &host_addr, sizeof(host_addr));
+}
+
+// the board answers pings, and takes data packets and tokens
+static void *board_thread(void *arg)
+{
+	uint8_t buf[MAX_FRAME_SIZE];
+	uint8_t ping[8] = { RAMP_PINGTYPE >> 8, RAMP_PINGTYPE & 0xFF, RAMP_CAP_FRAMES | RAMP_CAP_CREDITS, 0, 0, 0, BOARD_WINDOW };
+	uint8_t token[10] = { RAMP_TOKENTYPE >> 8, RAMP_TOKENTYPE & 0xFF };
+	socklen_t alen;
+	ssize_t len;
+	int type, i, n;
+
+	(void) arg;
+	for (;;) {
+		alen = sizeof(host_addr);
+		len = recvfrom(board_sock, buf, sizeof(buf), 0, (struct sockaddr *) &host_addr, &alen);
+		if (len < 4)
+			continue;
+
+		type = (buf[0] << 8) | buf[1];
+		if (type == RAMP_PINGTYPE) {
+			board_send(ping, sizeof(ping));
+			continue;
+		}
+
+		// every token and data packet carries a count
+		__atomic_fetch_add(&returned, (buf[2] << 8) | buf[3], __ATOMIC_ACQ_REL);
+		if (type == RAMP_TOKENTYPE || !(type & RAMP_CREDITFLAG))
+			continue;
+
+		// the words of a data packet are taken at once, and their credit
+		// returned in a single token
+		n = (type & ~RAMP_CREDITFLAG) / 8;
+		for (i = 0; i < n && nreceived < HOST_WORDS; i++) {
+			memcpy(&received[nreceived], &buf[2 + CREDIT_WORD_LEN + 8 * i], 8);
+			received[nreceived] = be64toh(received[nreceived]);
+			nreceived++;
+		}
+		token[2] = n >> 8;
+		token[3] = n;
+		board_send(token, sizeof(token));
+	}
+	return NULL;
+}
+
+static void board_send_words(int nwords)
+{
+	uint8_t pkt[2 + CREDIT_WORD_LEN + 8 * RAMP_FRAME_MAX_WORDS];
+	uint64_t word;
+	int i, n;
+
+	for (; nwords > 0; nwords -= n) {
+		n = (nwords < RAMP_FRAME_MAX_WORDS) ? nwords : RAMP_FRAME_MAX_WORDS;
+		memset(pkt, 0, sizeof(pkt));
+		pkt[0] = (RAMP_CREDITFLAG | (RAMP_DATATYPE * n)) >> 8;
+		pkt[1] = RAMP_DATATYPE * n;
+		for (i = 0; i < n; i++) {
+			word = htobe64(nwords - i);
+			memcpy(&pkt[2 + CREDIT_WORD_LEN + 8 * i], &word, 8);
+		}
+		board_send(pkt, 2 + CREDIT_WORD_LEN + 8 * n);
+	}
+}
+
+int main(void)
+{
+	ramp_chan_t channel;
+	struct sockaddr_in addr;
+	pthread_t board;
+	uint64_t words[HOST_WORDS], word;
+	int i, errors = 0;
+
+	board_sock = socket(AF_INET, SOCK_DGRAM, 0);
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(RAMP_UDP_PORT);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(board_sock, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+		perror("bind");
+		return -1;
+	}
+	pthread_create(&board, NULL, board_thread, NULL);
+
+	if (ramp_chan_init_udp(&channel, "127.0.0.1", RAMP_UDP_PORT) != 0) {
+		fprintf(stderr, "Error initializing channel\n");
+		return -1;
+	}
+	if (channel.tx_window != BOARD_WINDOW || !(channel.caps & RAMP_CAP_CREDITS)) {
+		fprintf(stderr, "Board's window or capabilities not taken from its ping reply\n");
+		return -1;
+	}
+
+	// a reader that stops with words still queued
+	board_send_words(BOARD_WORDS);
+	usleep(100000);
+	for (i = 0; i < 10; i++)
+		if (ramp_chan_read8B(&channel, &word) != 8)
+			errors++;
+	usleep(100000);
+	if (returned != 10) {
+		fprintf(stderr, "%u credits returned for 10 words read by a stalled reader\n", returned);
+		errors++;
+	}
+
+	// the rest of the words are read, and their credit comes back in tokens
+	// or in the credit words of data packets.  The write needs every counted
+	// token returned by the board to get past its window.
+	for (; i < BOARD_WORDS; i++)
+		if (ramp_chan_read8B(&channel, &word) != 8)
+			errors++;
+	for (i = 0; i < HOST_WORDS; i++)
+		words[i] = 0x0123456789ABCDEFULL * (i + 1);
+	alarm(10);
+	if (ramp_chan_write(&channel, words, HOST_WORDS) != HOST_WORDS) {
+		fprintf(stderr, "Error writing to channel\n");
+		errors++;
+	}
+	usleep(100000);
+
+	if (returned != BOARD_WORDS) {
+		fprintf(stderr, "%u credits returned for %d words read\n", returned, BOARD_WORDS);
+		errors++;
+	}
+	if (nreceived != HOST_WORDS || memcmp(received, words, sizeof(words)) != 0) {
+		fprintf(stderr, "Board received %d of %d words, or wrong words\n", nreceived, HOST_WORDS);
+		errors++;
+	}
+	if (channel.tx_credit != BOARD_WINDOW) {
+		fprintf(stderr, "Host has %u credits left, expected the board's window of %d\n", channel.tx_credit, BOARD_WINDOW);
+		errors++;
+	}
+
+	if (errors == 0)
+		printf("Test succeeded\n");
+
+	ramp_chan_close(&channel);
+	return errors ? -1 : 0;
+}
@@ -0,0 +1,128 @@
+/*
+ * Marshalling test: checks every byte swap variant the CPU supports against
+ * a byte by byte reference, for payloads of 0 to 70 words at every source
+ * and destination alignment, both in place and between buffers.  Bytes
+ * outside the payload must be left alone.  The variants are static, so the
+ * test includes ramp_marshal.c rather than linking it.
+ *
+ *	gcc -I../../../physical-devices/ethernet -o ramp_marshal_test ramp_marshal_test.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <endian.h>
+#include "ramp_marshal.c"
+
+#define MAX_WORDS	70
+#define GUARD		0xA5
+
+typedef void (*swap_fn)(uint8_t *dst, const uint8_t *src, size_t nwords);
+
+static uint8_t src_buf[8 * MAX_WORDS + 64];
+static uint8_t dst_buf[8 * MAX_WORDS + 64];
+static uint8_t expect[8 * MAX_WORDS + 64];
+
+static void swap_pack(uint8_t *dst, const uint8_t *src, size_t nwords)
+{
+	ramp_marshal_pack(dst, src, nwords);
+}
+
+static void swap_unpack(uint8_t *dst, const uint8_t *src, size_t nwords)
+{
+	ramp_marshal_unpack(dst, src, nwords);
+}
+
+#ifdef RAMP_MARSHAL_X86
+
+// the vector variants leave a remainder, which the scalar loop finishes
+static void swap_ssse3(uint8_t *dst, const uint8_t *src, size_t nwords)
+{
+	size_t i = ramp_marshal_swap_ssse3(dst, src, nwords);
+
+	ramp_marshal_swap_scalar(dst + 8 * i, src + 8 * i, nwords - i);
+}
+
+static void swap_avx2(uint8_t *dst, const uint8_t *src, size_t nwords)
+{
+	size_t i = ramp_marshal_swap_avx2(dst, src, nwords);
+
+	ramp_marshal_swap_scalar(dst + 8 * i, src + 8 * i, nwords - i);
+}
+
+#endif
+
+static int check(const char *name, swap_fn swap)
+{
+	size_t nwords, i, j, src_off, dst_off;
+	int in_place, errors = 0;
+	uint8_t *src, *dst;
+
+	for (nwords = 0; nwords <= MAX_WORDS; nwords++)
+	for (src_off = 0; src_off < 8; src_off++)
+	for (dst_off = 0; dst_off < 8; dst_off++)
+	for (in_place = 0; in_place < 2; in_place++) {
+		if (in_place && dst_off != src_off)
+			continue;
+
+		for (i = 0; i < sizeof(src_buf); i++)
+			src_buf[i] = i * 7 + nwords;
+		memset(dst_buf, GUARD, sizeof(dst_buf));
+		src = src_buf + src_off;
+		dst = in_place ? src : dst_buf + dst_off;
+
+		// on a little endian host, a word's bytes are reversed on their way
+		// to or from the wire
+		memcpy(expect, in_place ? src_buf : dst_buf, sizeof(expect));
+		for (i = 0; i < nwords; i++)
+			for (j = 0; j < 8; j++)
+				expect[(dst - (in_place ? src_buf : dst_buf)) + 8 * i + j] =
+					src[8 * i + ((__BYTE_ORDER == __LITTLE_ENDIAN) ? 7 - j : j)];
+
+		swap(dst, src, nwords);
+
+		if (memcmp(in_place ? src_buf : dst_buf, expect, sizeof(expect)) != 0) {
+			if (errors++ == 0)
+				fprintf(stderr, "%s: %zu words, source offset %zu, destination offset %zu%s: wrong bytes\n",
+					name, nwords, src_off, dst_off, in_place ? " (in place)" : "");
+		}
+	}
+
+	return errors;
+}
+
+int main(void)
+{
+	uint64_t word = 0x0102030405060708ULL, wire;
+	int errors = 0;
+
+	// the wire is most significant byte first, whatever the host order
+	ramp_marshal_pack(&wire, &word, 1);
+	if (((uint8_t *) &wire)[0] != 0x01 || ((uint8_t *) &wire)[7] != 0x08) {
+		fprintf(stderr, "pack: word not in network byte order\n");
+		errors++;
+	}
+	ramp_marshal_unpack(&wire, &wire, 1);
+	if (wire != word) {
+		fprintf(stderr, "unpack: word does not survive a round trip\n");
+		errors++;
+	}
+
+	errors += check("scalar", ramp_marshal_swap_scalar);
+	errors += check("pack", swap_pack);
+	errors += check("unpack", swap_unpack);
+#ifdef RAMP_MARSHAL_X86
+	if (__builtin_cpu_supports("ssse3"))
+		errors += check("ssse3", swap_ssse3);
+	else
+		printf("SSSE3 not supported, not tested\n");
+	if (__builtin_cpu_supports("avx2"))
+		errors += check("avx2", swap_avx2);
+	else
+		printf("AVX2 not supported, not tested\n");
+#endif
+
+	if (errors == 0)
+		printf("Test succeeded\n");
+	return errors ? -1 : 0;
+}
@@ -0,0 +1,190 @@
+/*
+ * Trace test: writes a channel trace and reads it back, reads back a trace
+ * whose writer died without closing it, and records a channel talking to
+ * a board model on the loopback interface that echoes every data word.
+ * The echoed words must be in the trace, stamped after the words that
+ * caused them, before the application has read any of them.
+ *
+ *	gcc -I../../../physical-devices/ethernet -o ramp_trace_test ramp_trace_test.c \
+ *		../../../physical-devices/ethernet/ramp_fifo.c \
+ *		../../../physical-devices/ethernet/ramp_marshal.c \
+ *		../../../physical-devices/ethernet/ramp_trace.c -lpthread
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <arpa/inet.h>
+#include "ramp_fifo.h"
+#include "ramp_trace.h"
+
+#define TRACE_PATH	"/tmp/ramp_trace_test.trc"
+#define NWORDS		100
+
+static int board_sock;
+
+// the board answers pings without any capabilities, and echoes data packets
+static void *board_thread(void *arg)
+{
+	uint8_t buf[MAX_FRAME_SIZE];
+	uint8_t ping[8] = { RAMP_PINGTYPE >> 8, RAMP_PINGTYPE & 0xFF };
+	struct sockaddr_in host_addr;
+	socklen_t alen;
+	ssize_t len;
+	int type;
+
+	(void) arg;
+	for (;;) {
+		alen = sizeof(host_addr);
+		len = recvfrom(board_sock, buf, sizeof(buf), 0, (struct sockaddr *) &host_addr, &alen);
+		if (len < 2)
+			continue;
+
+		type = (buf[0] << 8) | buf[1];
+		if (type == RAMP_PINGTYPE)
+			sendto(board_sock, ping, sizeof(ping), 0, (struct sockaddr *) &host_addr, alen);
+		else if (type == RAMP_DATATYPE)
+			sendto(board_sock, buf, len, 0, (struct sockaddr *) &host_addr, alen);
+	}
+	return NULL;
+}
+
+static int check_readback(void)
+{
+	ramp_trace_t trace;
+	const ramp_trace_rec_t *rec;
+	uint64_t i, last = 0;
+
+	if (ramp_trace_create(&trace, TRACE_PATH) != 0)
+		return 1;
+	for (i = 0; i < 1000; i++)
+		ramp_trace_record(&trace, i & 1, i * 0x0101010101010101ULL);
+	ramp_trace_close(&trace);
+
+	if (ramp_trace_open(&trace, TRACE_PATH) != 0)
+		return 1;
+	for (i = 0; (rec = ramp_trace_get(&trace, i)) != NULL; i++) {
+		if (rec->data != i * 0x0101010101010101ULL || (rec->stamp & 1) != (i & 1) || rec->stamp < last) {
+			fprintf(stderr, "read back: wrong record %lu\n", (unsigned long) i);
+			break;
+		}
+		last = rec->stamp;
+	}
+	ramp_trace_close(&trace);
+
+	if (i != 1000) {
+		fprintf(stderr, "read back: %lu of 1000 records\n", (unsigned long) i);
+		return 1;
+	}
+	return 0;
+}
+
+static int check_crash(void)
+{
+	ramp_trace_t trace;
+	uint64_t i, n;
+	pid_t pid;
+
+	// the writer exits without closing the trace
+	pid = fork();
+	if (pid == 0) {
+		if (ramp_trace_create(&trace, TRACE_PATH) != 0)
+			_exit(1);
+		for (i = 0; i < 777; i++)
+			ramp_trace_record(&trace, RAMP_TRACE_TO_FPGA, i);
+		_exit(0);
+	}
+	waitpid(pid, NULL, 0);
+
+	if (ramp_trace_open(&trace, TRACE_PATH) != 0)
+		return 1;
+	n = trace.nrecs;
+	ramp_trace_close(&trace);
+
+	if (n != 777) {
+		fprintf(stderr, "crash: %lu of 777 records\n", (unsigned long) n);
+		return 1;
+	}
+	return 0;
+}
+
+static int check_channel(void)
+{
+	ramp_chan_t channel;
+	ramp_trace_t trace;
+	const ramp_trace_rec_t *rec;
+	struct sockaddr_in addr;
+	pthread_t board;
+	uint64_t words[NWORDS], sent_stamp[NWORDS];
+	uint64_t i, nto = 0, nfrom = 0;
+	int errors = 0;
+
+	board_sock = socket(AF_INET, SOCK_DGRAM, 0);
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(RAMP_UDP_PORT);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(board_sock, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+		perror("bind");
+		return 1;
+	}
+	pthread_create(&board, NULL, board_thread, NULL);
+
+	if (ramp_chan_init_udp(&channel, "127.0.0.1", RAMP_UDP_PORT) != 0)
+		return 1;
+	if (ramp_trace_create(&trace, TRACE_PATH) != 0)
+		return 1;
+	ramp_chan_trace(&channel, &trace);
+
+	for (i = 0; i < NWORDS; i++)
+		words[i] = 0xA5A5000000000000ULL | i;
+	if (ramp_chan_write(&channel, words, NWORDS) != NWORDS)
+		return 1;
+
+	// nothing is read, so the echoes are only traced if the receive
+	// thread records them
+	usleep(200000);
+	ramp_chan_close(&channel);
+	ramp_trace_close(&trace);
+
+	if (ramp_trace_open(&trace, TRACE_PATH) != 0)
+		return 1;
+	for (i = 0; (rec = ramp_trace_get(&trace, i)) != NULL; i++) {
+		if ((rec->stamp & 1) == RAMP_TRACE_TO_FPGA) {
+			if (nto >= NWORDS || rec->data != words[nto])
+				errors++;
+			else
+				sent_stamp[nto++] = rec->stamp;
+		} else {
+			if (nfrom >= nto || rec->data != words[nfrom] || rec->stamp < sent_stamp[nfrom])
+				errors++;
+			nfrom++;
+		}
+	}
+	ramp_trace_close(&trace);
+
+	if (errors || nto != NWORDS || nfrom != NWORDS) {
+		fprintf(stderr, "channel: %lu sent and %lu received words traced, %d out of order\n",
+			(unsigned long) nto, (unsigned long) nfrom, errors);
+		return 1;
+	}
+	return 0;
+}
+
+int main(void)
+{
+	int errors = 0;
+
+	errors += check_readback();
+	errors += check_crash();
+	errors += check_channel();
+	unlink(TRACE_PATH);
+
+	if (errors == 0)
+		printf("Test succeeded\n");
+	return errors ? -1 : 0;
+}
@@ -0,0 +1,386 @@
+//==============================================================================
+//	Section:	License
+//==============================================================================
+//	Copyright (c) 2005-2009, Regents of the University of California
+//	All rights reserved.
+//
+//	Redistribution and use in source and binary forms, with or without modification,
+//	are permitted provided that the following conditions are met:
+//
+//		- Redistributions of source code must retain the above copyright notice,
+//			this list of conditions and the following disclaimer.
+//		- Redistributions in binary form must reproduce the above copyright
+//			notice, this list of conditions and the following disclaimer
+//			in the documentation and/or other materials provided with the
+//			distribution.
+//		- Neither the name of the University of California, Berkeley nor the
+//			names of its contributors may be used to endorse or promote
+//			products derived from this software without specific prior
+//			written permission.
+//
+//	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+//	ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+//	ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+//------------------------------------------------------------------------------
+//	Module:		EthernetFIFORxTest
+//	Description:	Simulation testbench for the compressed data and credit
+//			paths of EthernetFIFORx.  A simple MAC model delivers raw
+//			frames, and every word written to the RX FIFO and every
+//			credit handed to the TX side is checked against what the
+//			frames should produce.  Compressed packets with and without a
+//			credit word, a data packet with a credit word and a counted
+//			token are sent, then a group that expands to the maximum 64
+//			words directly followed by a cut-through data packet, whose
+//			words must wait in the hold queue.  Finally, groups with no
+//			slots, too many slots or too many repeats must be dropped
+//			without writing any words, and raise rx_error.
+//
+//			iverilog -o tb EthernetFIFORxTest.v \
+//				../../../physical-devices/ethernet/EthernetFIFORx.v && vvp tb
+//
+//	Author:		Rimas Avizienis
+//	Version:
+//------------------------------------------------------------------------------
+
+`timescale 1ns / 1ps
+
+module EthernetFIFORxTest;
+
+	localparam		MACAddress =	48'h112233445566,
+				HostMAC =	48'h0A0B0C0D0E0F,
+				MaxWords =	256;
+
+	reg			clk, reset;
+	reg [7:0]		rxd;
+	reg			rxdv, rx_good_frame;
+	wire			rxfifo_we, tx_credit_incr, rx_error;
+	wire [63:0]		rx_dout;
+	wire [7:0]		rx_host_caps;
+
+	//	frame under construction
+	reg [7:0]		frame [0:1535];
+	integer			flen;
+
+	//	words and credit the DUT should produce, and what it did produce
+	reg [63:0]		expect_words [0:MaxWords-1];
+	reg [63:0]		got_words [0:MaxWords-1];
+	integer			nexpect, ngot, expect_credits, credits;
+	integer			errors, i;
+
+	EthernetFIFORx #(
+			.MACAddress		(MACAddress),
+			.CompressEnable		(1),
+			.BulkEnable		(0),
+			.CutThrough		(1),
+			.MaxFrameWords		(64),
+			.CreditEnable		(1),
+			.UDPEnable		(0)
+			) dut (
+			.clk			(clk),
+			.reset			(reset),
+			.rxd			(rxd),
+			.rxdv			(rxdv),
+			.rx_good_frame		(rx_good_frame),
+			.rx_bad_frame		(1'b0),
+			.rxfifo_full		(1'b0),
+			.rxfifo_we		(rxfifo_we),
+			.rx_dout		(rx_dout),
+			.bulkfifo_full		(1'b0),
+			.bulkfifo_we		(),
+			.bulk_dout		(),
+			.bulkdesc_we		(),
+			.bulk_desc		(),
+			.tx_send_ack		(),
+			.tx_credit_incr		(tx_credit_incr),
+			.rx_source_mac		(),
+			.rx_host_caps		(rx_host_caps),
+			.rx_host_udp		(),
+			.rx_source_ip		(),
+			.rx_source_port		(),
+			.rx_error		(rx_error));
+
+	always #4 clk = ~clk;
+
+	always @(posedge clk) begin
+		if (rxfifo_we) begin
+			if (ngot < MaxWords)
+				got_words[ngot] <= rx_dout;
+			ngot <= ngot + 1;
+		end
+		if (tx_credit_incr)
+			credits <= credits + 1;
+	end
+
+	task fail;
+		input [8*48-1:0] what;
+		begin
+			$display("FAIL: %0s", what);
+			errors = errors + 1;
+		end
+	endtask
+
+	//	frame building: ethernet header, then the packet type
+	task start_frame;
+		input [15:0] pkt_type;
+		begin
+			flen = 0;
+			for (i = 0; i < 6; i = i + 1)
+				frame[i] = MACAddress >> (8 * (5 - i));
+			for (i = 0; i < 6; i = i + 1)
+				frame[6 + i] = HostMAC >> (8 * (5 - i));
+			frame[12] = 8'h88;
+			frame[13] = 8'h88;
+			frame[14] = pkt_type[15:8];
+			frame[15] = pkt_type[7:0];
+			flen = 16;
+		end
+	endtask
+
+	task put8;
+		input [7:0] b;
+		begin
+			frame[flen] = b;
+			flen = flen + 1;
+		end
+	endtask
+
+	task put64;
+		input [63:0] w;
+		begin
+			for (i = 0; i < 8; i = i + 1)
+				frame[flen + i] = w >> (8 * (7 - i));
+			flen = flen + 8;
+		end
+	endtask
+
+	//	a credit word holds its count in its first two bytes
+	task put_credit;
+		input [15:0] count;
+		begin
+			put64({count, 48'h000000000000});
+			expect_credits = expect_credits + count;
+		end
+	endtask
+
+	task expect_word;
+		input [63:0] w;
+		begin
+			expect_words[nexpect] = w;
+			nexpect = nexpect + 1;
+		end
+	endtask
+
+	//	MAC model: the frame (padded to the minimum size) with rxdv high,
+	//	then the good frame status a couple of cycles later, then gap idle
+	//	cycles before the next frame
+	task send_frame;
+		input integer gap;
+		begin
+			while (flen < 60)
+				put8(8'h00);
+			for (i = 0; i < flen; i = i + 1) begin
+				rxd <= frame[i];
+				rxdv <= 1'b1;
+				@(posedge clk);
+			end
+			rxdv <= 1'b0;
+			repeat (2) @(posedge clk);
+			rx_good_frame <= 1'b1;
+			@(posedge clk);
+			rx_good_frame <= 1'b0;
+			repeat (gap) @(posedge clk);
+		end
+	endtask
+
+	//	compressed group header: nslots, bitmap, repeat, reserved
+	task put_cheader;
+		input [7:0] nslots, bitmap, repeat_count;
+		begin
+			put8(nslots);
+			put8(bitmap);
+			put8(repeat_count);
+			put8(8'h00);
+		end
+	endtask
+
+	task check_words;
+		input [8*32-1:0] what;
+		begin
+			if (ngot != nexpect) begin
+				$display("FAIL: %0s: %0d words written, expected %0d", what, ngot, nexpect);
+				errors = errors + 1;
+			end
+			else
+				for (i = 0; i < nexpect; i = i + 1)
+					if (got_words[i] != expect_words[i]) begin
+						$display("FAIL: %0s: word %0d is %h, expected %h", what, i, got_words[i], expect_words[i]);
+						errors = errors + 1;
+					end
+			if (credits != expect_credits) begin
+				$display("FAIL: %0s: %0d credits returned, expected %0d", what, credits, expect_credits);
+				errors = errors + 1;
+			end
+			ngot = 0;
+			nexpect = 0;
+			credits = 0;
+			expect_credits = 0;
+		end
+	endtask
+
+	task reset_dut;
+		begin
+			reset <= 1'b1;
+			repeat (4) @(posedge clk);
+			reset <= 1'b0;
+			repeat (4) @(posedge clk);
+
+			// the host advertises credit words and counted tokens
+			start_frame(16'hFFFE);
+			put8(8'h0F);
+			send_frame(16);
+			if (rx_host_caps != 8'h0F)
+				fail("host capabilities not taken from the ping");
+		end
+	endtask
+
+	task check_dropped;
+		input [8*32-1:0] what;
+		begin
+			if (~rx_error)
+				fail("bad group header did not raise rx_error");
+			check_words(what);
+			reset_dut;
+		end
+	endtask
+
+	initial begin
+		clk = 1'b0;
+		reset = 1'b1;
+		rxd = 8'h00;
+		rxdv = 1'b0;
+		rx_good_frame = 1'b0;
+		errors = 0;
+		ngot = 0;
+		nexpect = 0;
+		credits = 0;
+		expect_credits = 0;
+		reset_dut;
+
+		// zero slot and literals, the last slot repeated
+		start_frame(16'h0009);
+		put_cheader(8'd3, 8'b10100000, 8'd4);
+		put64(64'h0123456789ABCDEF);
+		put64(64'hFEDCBA9876543210);
+		send_frame(80);
+		expect_word(64'h0123456789ABCDEF);
+		expect_word(64'h0000000000000000);
+		for (i = 0; i < 5; i = i + 1)
+			expect_word(64'hFEDCBA9876543210);
+		check_words("compressed packet");
+
+		// all slots literal, behind a credit word
+		start_frame(16'h4009);
+		put_credit(16'd5);
+		put_cheader(8'd8, 8'hFF, 8'd0);
+		put64(64'h1111111111111111);
+		put64(64'h2222222222222222);
+		put64(64'h3333333333333333);
+		put64(64'h4444444444444444);
+		put64(64'h5555555555555555);
+		put64(64'h6666666666666666);
+		put64(64'h7777777777777777);
+		put64(64'h8888888888888888);
+		send_frame(80);
+		expect_word(64'h1111111111111111);
+		expect_word(64'h2222222222222222);
+		expect_word(64'h3333333333333333);
+		expect_word(64'h4444444444444444);
+		expect_word(64'h5555555555555555);
+		expect_word(64'h6666666666666666);
+		expect_word(64'h7777777777777777);
+		expect_word(64'h8888888888888888);
+		check_words("compressed packet with credit");
+
+		// no literals at all: a zero word repeated
+		start_frame(16'h4009);
+		put_credit(16'd1);
+		put_cheader(8'd1, 8'h00, 8'd9);
+		send_frame(80);
+		for (i = 0; i < 10; i = i + 1)
+			expect_word(64'h0000000000000000);
+		check_words("all zero compressed packet");
+
+		// a multi-word data packet behind a credit word
+		start_frame(16'h4000 | 16'd16);
+		put_credit(16'd300);
+		put64(64'hA5A5A5A5A5A5A5A5);
+		put64(64'h5A5A5A5A5A5A5A5A);
+		send_frame(400);
+		expect_word(64'hA5A5A5A5A5A5A5A5);
+		expect_word(64'h5A5A5A5A5A5A5A5A);
+		check_words("data packet with credit");
+
+		// a counted token
+		start_frame(16'hFFFF);
+		put_credit(16'd7);
+		send_frame(16);
+		check_words("counted token");
+
+		// the largest group, then a data packet whose words arrive while it
+		// is still being expanded
+		start_frame(16'h0009);
+		put_cheader(8'd1, 8'h80, 8'd63);
+		put64(64'hC0FFEEC0FFEEC0FF);
+		send_frame(4);
+		for (i = 0; i < 64; i = i + 1)
+			expect_word(64'hC0FFEEC0FFEEC0FF);
+		start_frame(16'd24);
+		put64(64'h0000000000000001);
+		put64(64'h0000000000000002);
+		put64(64'h0000000000000003);
+		send_frame(80);
+		expect_word(64'h0000000000000001);
+		expect_word(64'h0000000000000002);
+		expect_word(64'h0000000000000003);
+		check_words("64 word group and held words");
+		if (rx_error)
+			fail("rx_error raised by valid packets");
+
+		// bad group headers are dropped, credit word and all
+		start_frame(16'h4009);
+		put_credit(16'd2);
+		put_cheader(8'd0, 8'h00, 8'd4);
+		send_frame(80);
+		expect_credits = 0;
+		check_dropped("group with no slots");
+
+		start_frame(16'h0009);
+		put_cheader(8'd9, 8'h80, 8'd0);
+		put64(64'hDEADBEEFDEADBEEF);
+		send_frame(80);
+		check_dropped("group with 9 slots");
+
+		start_frame(16'h0009);
+		put_cheader(8'd2, 8'hC0, 8'd63);
+		put64(64'hDEADBEEFDEADBEEF);
+		put64(64'hDEADBEEFDEADBEEF);
+		send_frame(80);
+		check_dropped("group of 65 words");
+
+		if (errors == 0)
+			$display("PASS");
+		else
+			$display("FAIL: %0d errors", errors);
+		$finish;
+	end
+
+endmodule
@@ -0,0 +1,239 @@
+//==============================================================================
+//	Section:	License
+//==============================================================================
+//	Copyright (c) 2005-2009, Regents of the University of California
+//	All rights reserved.
+//
+//	Redistribution and use in source and binary forms, with or without modification,
+//	are permitted provided that the following conditions are met:
+//
+//		- Redistributions of source code must retain the above copyright notice,
+//			this list of conditions and the following disclaimer.
+//		- Redistributions in binary form must reproduce the above copyright
+//			notice, this list of conditions and the following disclaimer
+//			in the documentation and/or other materials provided with the
+//			distribution.
+//		- Neither the name of the University of California, Berkeley nor the
+//			names of its contributors may be used to endorse or promote
+//			products derived from this software without specific prior
+//			written permission.
+//
+//	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+//	ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+//	ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+//------------------------------------------------------------------------------
+//	Module:		EthernetFIFOSpillTest
+//	Description:	Simulation testbench for the DDR2 spill ring buffer in
+//			EthernetFIFOSpill.  A numbered stream of words is pushed
+//			through it while a slow, bursty reader forces words into a
+//			small ring and wraps it many times.  A DDR2 model accepts
+//			requests at random, answers reads in order after a fixed
+//			latency, and checks that no word is overwritten before it
+//			is read back, nor read before it is written.  Every word
+//			must come out of the output FIFO exactly once, in order,
+//			and the output FIFO must never overflow.
+//
+//			iverilog -o tb EthernetFIFOSpillTest.v \
+//				../../../physical-devices/ethernet/EthernetFIFOSpill.v && vvp tb
+//
+//	Author:		Rimas Avizienis
+//	Version:
+//------------------------------------------------------------------------------
+
+`timescale 1ns / 1ps
+
+module EthernetFIFOSpillTest;
+
+	localparam		SpillBase =	64'h0000000000000100,
+				SpillAWidth =	6,
+				SpillWords =	1 << SpillAWidth,
+				OutDepth =	512,
+				Latency =	20,
+				Words =		20000,
+				Timeout =	2000000;
+
+	reg			clk, reset;
+	integer			cycles, errors, spills, k;
+
+	//	source: the RX FIFO holds the numbered stream, with random gaps
+	reg [63:0]		next_in;
+	reg			src_stall;
+	wire			rxfifo_empty, rxfifo_re;
+
+	//	output FIFO and the reader behind it
+	reg [63:0]		outq [0:OutDepth-1];
+	reg [8:0]		outq_head, outq_tail;
+	reg [9:0]		outq_count;
+	reg [63:0]		next_out;
+	reg			sink_ready;
+	wire			outfifo_we, outfifo_re;
+	wire [63:0]		outfifo_data;
+
+	//	DDR2: one word per slot of the ring, and whether it holds a word
+	//	not yet read back
+	reg [63:0]		mem [0:SpillWords-1];
+	reg [SpillWords-1:0]	live;
+	reg			wr_accept, rd_accept;
+	reg [63:0]		rsp_data [0:Latency-1];
+	reg [Latency-1:0]	rsp_valid;
+	wire [63:0]		spill_wr_addr, spill_wr_data, spill_rd_addr;
+	wire			spill_wr_valid, spill_wr_deq, spill_rd_valid, spill_rd_deq;
+	wire [63:0]		wr_offset, rd_offset;
+	wire [SpillAWidth-1:0]	wr_slot, rd_slot;
+
+	EthernetFIFOSpill #(
+			.SpillBase		(SpillBase),
+			.SpillAWidth		(SpillAWidth)
+			) dut (
+			.clk			(clk),
+			.reset			(reset),
+			.rxfifo_empty		(rxfifo_empty),
+			.rxfifo_re		(rxfifo_re),
+			.rxfifo_data		(next_in),
+			.outfifo_we		(outfifo_we),
+			.outfifo_data		(outfifo_data),
+			.outfifo_re		(outfifo_re),
+			.spill_wr_addr		(spill_wr_addr),
+			.spill_wr_data		(spill_wr_data),
+			.spill_wr_valid		(spill_wr_valid),
+			.spill_wr_deq		(spill_wr_deq),
+			.spill_rd_addr		(spill_rd_addr),
+			.spill_rd_valid		(spill_rd_valid),
+			.spill_rd_deq		(spill_rd_deq),
+			.spill_rsp_data		(rsp_data[Latency-1]),
+			.spill_rsp_valid	(rsp_valid[Latency-1]));
+
+	always #4 clk = ~clk;
+
+	assign rxfifo_empty =	(next_in == Words) | src_stall;
+	assign outfifo_re =	sink_ready & (outq_count != 0);
+	assign spill_wr_deq =	spill_wr_valid & wr_accept;
+	assign spill_rd_deq =	spill_rd_valid & rd_accept;
+	assign wr_offset =	spill_wr_addr - SpillBase;
+	assign rd_offset =	spill_rd_addr - SpillBase;
+	assign wr_slot =	wr_offset[SpillAWidth+2:3];
+	assign rd_slot =	rd_offset[SpillAWidth+2:3];
+
+	task fail;
+		input [8*48-1:0] what;
+		begin
+			if (errors < 10)
+				$display("FAIL cycle %0d: %0s", cycles, what);
+			errors = errors + 1;
+		end
+	endtask
+
+	always @(posedge clk) begin
+		if (reset) begin
+			next_in <= 64'd0;
+			next_out <= 64'd0;
+			outq_head <= 9'd0;
+			outq_tail <= 9'd0;
+			outq_count <= 10'd0;
+			live <= {SpillWords{1'b0}};
+			rsp_valid <= {Latency{1'b0}};
+		end
+		else begin
+			if (rxfifo_re) begin
+				if (rxfifo_empty)
+					fail("read from an empty RX FIFO");
+				next_in <= next_in + 1;
+			end
+
+			if (outfifo_we) begin
+				if (outq_count == OutDepth & ~outfifo_re)
+					fail("output FIFO overflow");
+				outq[outq_head] <= outfifo_data;
+				outq_head <= outq_head + 1;
+			end
+			if (outfifo_re) begin
+				if (outq[outq_tail] != next_out) begin
+					$display("FAIL cycle %0d: word %0d read, expected %0d", cycles, outq[outq_tail], next_out);
+					errors = errors + 1;
+				end
+				next_out <= next_out + 1;
+				outq_tail <= outq_tail + 1;
+			end
+			outq_count <= outq_count + outfifo_we - outfifo_re;
+
+			// DDR2 takes requests in order, so a read returns the word in its
+			// slot when the read was accepted
+			if (spill_wr_deq) begin
+				if (wr_offset[2:0] != 3'b000 | wr_offset >= 8 * SpillWords)
+					fail("write outside the ring");
+				if (live[wr_slot])
+					fail("word overwritten before it was read back");
+				mem[wr_slot] <= spill_wr_data;
+				live[wr_slot] <= 1'b1;
+				spills = spills + 1;
+			end
+			if (spill_rd_deq) begin
+				if (rd_offset[2:0] != 3'b000 | rd_offset >= 8 * SpillWords)
+					fail("read outside the ring");
+				if (~live[rd_slot])
+					fail("slot read before it was written");
+				live[rd_slot] <= 1'b0;
+			end
+			rsp_valid <= {rsp_valid[Latency-2:0], spill_rd_deq};
+			for (k = Latency - 1; k > 0; k = k - 1)
+				rsp_data[k] <= rsp_data[k - 1];
+			rsp_data[0] <= mem[rd_slot];
+		end
+	end
+
+	//	the reader is slow at first, so the ring fills and stalls the
+	//	source, then bursty, then takes a word whenever there is one
+	always @(posedge clk) begin
+		cycles <= cycles + 1;
+		src_stall <= ($random & 7) == 0;
+		wr_accept <= ($random & 3) != 0;
+		rd_accept <= ($random & 3) != 0;
+		if (next_out < Words / 3)
+			sink_ready <= ($random & 7) == 0;
+		else if (next_out < 2 * Words / 3)
+			sink_ready <= ($random & 63) < 24;
+		else
+			sink_ready <= 1'b1;
+	end
+
+	initial begin
+		clk = 1'b0;
+		reset = 1'b1;
+		cycles = 0;
+		errors = 0;
+		spills = 0;
+		src_stall = 1'b0;
+		sink_ready = 1'b0;
+		wr_accept = 1'b0;
+		rd_accept = 1'b0;
+		repeat (4) @(posedge clk);
+		reset <= 1'b0;
+
+		while (next_out != Words & cycles < Timeout)
+			@(posedge clk);
+		repeat (2 * Latency) @(posedge clk);
+
+		if (next_out != Words)
+			fail("not every word came out");
+		if (outq_count != 0 | live != 0 | rsp_valid != 0)
+			fail("words left behind");
+		if (spills < 4 * SpillWords)
+			fail("the ring was not wrapped");
+
+		if (errors == 0)
+			$display("PASS: %0d words, %0d through DDR2", Words, spills);
+		else
+			$display("FAIL: %0d errors", errors);
+		$finish;
+	end
+
+endmodule
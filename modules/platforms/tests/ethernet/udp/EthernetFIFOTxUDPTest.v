@@ -0,0 +1,293 @@
+//==============================================================================
+//	Section:	License
+//==============================================================================
+//	Copyright (c) 2005-2009, Regents of the University of California
+//	All rights reserved.
+//
+//	Redistribution and use in source and binary forms, with or without modification,
+//	are permitted provided that the following conditions are met:
+//
+//		- Redistributions of source code must retain the above copyright notice,
+//			this list of conditions and the following disclaimer.
+//		- Redistributions in binary form must reproduce the above copyright
+//			notice, this list of conditions and the following disclaimer
+//			in the documentation and/or other materials provided with the
+//			distribution.
+//		- Neither the name of the University of California, Berkeley nor the
+//			names of its contributors may be used to endorse or promote
+//			products derived from this software without specific prior
+//			written permission.
+//
+//	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+//	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+//	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+//	ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+//	ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+//------------------------------------------------------------------------------
+//	Module:		EthernetFIFOTxUDPTest
+//	Description:	Simulation testbench for the UDP encapsulation in
+//			EthernetFIFOTx.  A simple MAC model captures each frame, which
+//			is checked byte for byte: the IP and UDP lengths must match
+//			the bytes actually sent, the IP header checksum must verify,
+//			and the packet type must follow the UDP header.  A ping
+//			reply, a counted token and a multi-word data packet are sent
+//			over UDP, then a ping reply in a raw frame.
+//
+//			iverilog -o tb EthernetFIFOTxUDPTest.v \
+//				../../../physical-devices/ethernet/EthernetFIFOTx.v && vvp tb
+//
+//	Author:		Rimas Avizienis
+//	Version:
+//------------------------------------------------------------------------------
+
+`timescale 1ns / 1ps
+
+module EthernetFIFOTxUDPTest;
+
+	localparam		MACAddress =	48'h112233445566,
+				IPAddress =	32'hC0A80A02,
+				UDPPort =	16'h8888,
+				HostMAC =	48'h0A0B0C0D0E0F,
+				HostIP =	32'hC0A80A01,
+				HostPort =	16'hD431,
+				DataWords =	3;
+
+	reg			clk, reset;
+	wire [7:0]		txd;
+	wire			txen, tx_ack;
+
+	reg [63:0]		fifo_words [0:DataWords-1];
+	reg [3:0]		fifo_head, fifo_count;
+	wire			txfifo_empty, txfifo_re;
+	wire [63:0]		txfifo_data;
+
+	reg [7:0]		tokens;
+	wire			tx_send_token, rx_token_decr, tx_credit_decr;
+	reg			tx_send_ack, tx_host_udp;
+
+	//	MAC model: acknowledges the first byte a few cycles after txen rises,
+	//	then takes a byte every cycle until txen falls
+	reg			acked;
+	reg [1:0]		ack_wait;
+	reg [7:0]		frame [0:1023];
+	integer			len, errors, frames;
+	reg			prev_txen;
+	reg [15:0]		expect_type;
+
+	integer			i, j, sum, ip_len, udp_len, body;
+	reg [15:0]		pkt_type;
+	reg [63:0]		word;
+
+	EthernetFIFOTx #(
+			.MACAddress		(MACAddress),
+			.IPAddress		(IPAddress),
+			.UDPPort		(UDPPort),
+			.CompressEnable		(0),
+			.TxFillTimeout		(8)
+			) dut (
+			.clk			(clk),
+			.reset			(reset),
+			.txd			(txd),
+			.txen			(txen),
+			.tx_ack			(tx_ack),
+			.txfifo_empty		(txfifo_empty),
+			.txfifo_re		(txfifo_re),
+			.txfifo_data		(txfifo_data),
+			.tx_credit_avail	(1'b1),
+			.tx_credit_decr		(tx_credit_decr),
+			.tx_send_token		(tx_send_token),
+			.tx_send_ack		(tx_send_ack),
+			.rx_token_decr		(rx_token_decr),
+			.tx_dest_mac		(HostMAC),
+			.tx_host_caps		(8'h0C),
+			.tx_host_udp		(tx_host_udp),
+			.tx_dest_ip		(HostIP),
+			.tx_dest_port		(HostPort),
+			.tx_send_bulk_ack	(1'b0),
+			.tx_bulk_ack		(9'h000),
+			.bulk_ack_re		());
+
+	assign	tx_ack =	txen & ~acked & (ack_wait == 2'b11);
+	assign	txfifo_empty =	(fifo_count == 4'h0);
+	assign	txfifo_data =	fifo_words[fifo_head];
+	assign	tx_send_token =	(tokens != 8'h00);
+
+	always #4 clk = ~clk;
+
+	always @(posedge clk) begin
+		if (reset | ~txen) begin
+			acked <= 1'b0;
+			ack_wait <= 2'b00;
+		end
+		else if (~acked) begin
+			ack_wait <= ack_wait + 1;
+			if (tx_ack)
+				acked <= 1'b1;
+		end
+
+		if (txen & (acked | tx_ack)) begin
+			frame[len] <= txd;
+			len <= len + 1;
+		end
+
+		if (txfifo_re) begin
+			fifo_head <= fifo_head + 1;
+			fifo_count <= fifo_count - 1;
+		end
+
+		if (rx_token_decr)
+			tokens <= tokens - 1;
+
+		prev_txen <= txen;
+		if (prev_txen & ~txen) begin
+			check_frame;
+			len <= 0;
+		end
+	end
+
+	task fail;
+		input [8*48-1:0] what;
+		begin
+			$display("FAIL frame %0d (type %h): %0s", frames, expect_type, what);
+			errors = errors + 1;
+		end
+	endtask
+
+	task check_frame;
+		begin
+			if ({frame[0], frame[1], frame[2], frame[3], frame[4], frame[5]} != HostMAC)
+				fail("destination MAC");
+			if ({frame[6], frame[7], frame[8], frame[9], frame[10], frame[11]} != MACAddress)
+				fail("source MAC");
+
+			if (tx_host_udp) begin
+				if ({frame[12], frame[13]} != 16'h0800)
+					fail("ethertype");
+				if (frame[14] != 8'h45 | frame[23] != 8'h11)
+					fail("IP version or protocol");
+
+				ip_len = {frame[16], frame[17]};
+				udp_len = {frame[38], frame[39]};
+				if (len != 14 + ip_len)
+					fail("IP length does not match the bytes sent");
+				if (udp_len != ip_len - 20)
+					fail("UDP length");
+
+				sum = 0;
+				for (i = 14; i < 34; i = i + 2)
+					sum = sum + {frame[i], frame[i+1]};
+				sum = (sum & 16'hFFFF) + (sum >> 16);
+				sum = (sum & 16'hFFFF) + (sum >> 16);
+				if (sum != 16'hFFFF)
+					fail("IP header checksum");
+
+				if ({frame[26], frame[27], frame[28], frame[29]} != IPAddress |
+				    {frame[30], frame[31], frame[32], frame[33]} != HostIP)
+					fail("IP addresses");
+				if ({frame[34], frame[35]} != UDPPort | {frame[36], frame[37]} != HostPort)
+					fail("UDP ports");
+
+				pkt_type = {frame[42], frame[43]};
+				body = 44;
+			end
+			else begin
+				if ({frame[12], frame[13]} != 16'h8888)
+					fail("ethertype");
+				pkt_type = {frame[14], frame[15]};
+				body = 16;
+			end
+
+			// data packets carry the credit word flag in the type
+			if (pkt_type[15:14] != 2'b11)
+				pkt_type = pkt_type & 16'h3FFF;
+			if (pkt_type != expect_type)
+				fail("packet type");
+
+			// a data packet's length must cover its words (and credit word)
+			if (expect_type == 8 * DataWords) begin
+				if (len != body + ((frame[body-2] & 8'h40) ? 8 : 0) + expect_type)
+					fail("data packet length");
+				for (i = 0; i < DataWords; i = i + 1) begin
+					for (j = 0; j < 8; j = j + 1)
+						word = {word[55:0], frame[len - 8 * (DataWords - i) + j]};
+					if (word != fifo_words[i])
+						fail("data word");
+				end
+			end
+
+			// a counted token returns everything that was banked
+			if (expect_type == 16'hFFFF & {frame[body], frame[body+1]} != 16'h0003)
+				fail("token count");
+
+			frames = frames + 1;
+		end
+	endtask
+
+	task wait_frame;
+		begin
+			@(posedge clk);
+			while (~txen) @(posedge clk);
+			while (txen) @(posedge clk);
+			repeat (4) @(posedge clk);
+		end
+	endtask
+
+	initial begin
+		clk = 1'b0;
+		reset = 1'b1;
+		len = 0;
+		errors = 0;
+		frames = 0;
+		prev_txen = 1'b0;
+		tokens = 8'h00;
+		tx_send_ack = 1'b0;
+		tx_host_udp = 1'b1;
+		fifo_head = 4'h0;
+		fifo_count = 4'h0;
+		fifo_words[0] = 64'h0123456789ABCDEF;
+		fifo_words[1] = 64'hFEDCBA9876543210;
+		fifo_words[2] = 64'h00000000DEADBEEF;
+		repeat (4) @(posedge clk);
+		reset <= 1'b0;
+		repeat (4) @(posedge clk);
+
+		// ping reply over UDP
+		expect_type = 16'hFFFE;
+		tx_send_ack <= 1'b1;
+		@(posedge clk);
+		tx_send_ack <= 1'b0;
+		wait_frame;
+
+		// counted token over UDP
+		expect_type = 16'hFFFF;
+		tokens <= 8'h03;
+		wait_frame;
+
+		// multi-word data packet over UDP
+		expect_type = 8 * DataWords;
+		fifo_count <= DataWords;
+		wait_frame;
+
+		// ping reply in a raw frame
+		tx_host_udp = 1'b0;
+		expect_type = 16'hFFFE;
+		tx_send_ack <= 1'b1;
+		@(posedge clk);
+		tx_send_ack <= 1'b0;
+		wait_frame;
+
+		if (errors == 0 & frames == 4)
+			$display("PASS");
+		else
+			$display("FAIL: %0d errors in %0d frames", errors, frames);
+		$finish;
+	end
+
+endmodule